@@ -1,12 +1,16 @@
-#ifndef RBBST_H
-#define RBBST_H
+#ifndef AVLBST_H
+#define AVLBST_H
 
 #include <iostream>
 #include <exception>
 #include <cstdlib>
 #include <cstdint>
 #include <algorithm>
+#include <stdexcept>
+#include <vector>
+#include <utility>
 #include "bst.h"
+#include "countingbloom.h"
 
 struct KeyError { };
 
@@ -132,17 +136,136 @@ template <class Key, class Value>
 class AVLTree : public BinarySearchTree<Key, Value>
 {
 public:
+    AVLTree();
+    AVLTree(const AVLTree<Key, Value>& other);
+    AVLTree(AVLTree<Key, Value>&& other);
+    AVLTree<Key, Value>& operator=(const AVLTree<Key, Value>& other);
+    AVLTree<Key, Value>& operator=(AVLTree<Key, Value>&& other);
+    virtual ~AVLTree();
+
     virtual void insert (const std::pair<const Key, Value> &new_item); // TODO
     virtual void remove(const Key& key);  // TODO
+    virtual void erase(const Key& lo, const Key& hi);
+
+    // Set operations. Each one consumes other, reusing its nodes where it can
+    // and leaving it empty. Where a key is in both trees the union keeps the
+    // value from other (as insert would) and the intersection keeps ours.
+    void unionWith(AVLTree<Key, Value>& other);
+    void intersect(AVLTree<Key, Value>& other);
+    void difference(AVLTree<Key, Value>& other);
+
+    // Range moves. splitOff takes every key at or above key out into a new
+    // tree; concat appends other, whose keys must all be above ours, and
+    // leaves it empty. Both are O(log n) apart from keeping size and the
+    // filter up to date for the keys that move.
+    AVLTree<Key, Value> splitOff(const Key& key);
+    void concat(AVLTree<Key, Value>& other);
+
+    // Batch updates. The batch is sorted and split against the tree, so each
+    // half of it meets only its own half of the tree and the halves of large
+    // batches run as tasks on the shared WorkStealingPool; the pieces are
+    // joined back along the seams. insert_batch takes key/value pairs, the last of equal keys
+    // winning as with repeated inserts; remove_batch takes keys.
+    template<class InputIt>
+    void insert_batch(InputIt first, InputIt last);
+    template<class InputIt>
+    void remove_batch(InputIt first, InputIt last);
+
+    // Batched lookup. out[i] becomes what find(keys[i]) would return. Up to
+    // AVL_FIND_LANES descents advance in turn, each prefetching the node it
+    // visits next, so their cache misses overlap instead of queueing.
+    void find_many(const std::vector<Key>& keys,
+                   std::vector<typename BinarySearchTree<Key, Value>::iterator>& out) const;
+
+    // Relaxed balance. While relaxed, insert and remove skip the rotations
+    // and only mark the path above the change as out of date; rebalance()
+    // then repairs every marked node in one pass. It runs by itself once
+    // updateBudget updates have been deferred (0 for no limit) or an insert
+    // lands about twice as deep as an AVL tree of that size allows.
+    void setRelaxed(bool relaxed, size_t updateBudget = 0);
+    bool isRelaxed() const;
+    void rebalance();
+
+    // An optional counting Bloom filter over the keys, checked before every
+    // lookup descends, so most lookups of absent keys stop after one or two
+    // cache lines. It follows every insert and remove and is rebuilt after
+    // bulk operations. Needs std::hash<Key>.
+    void enableFilter(size_t expectedKeys = 0);
+    void disableFilter();
+    bool hasFilter() const;
+
+    // An optional direct-mapped cache from key hash to node, probed before
+    // the filter and the descent, so a repeated lookup of a hot key costs
+    // one probe. Rotations keep every node, so only freeing a node or
+    // moving it to another tree drops entries. Lookups write to the cache,
+    // so a tree using it must not be read from several threads at once.
+    // Needs std::hash<Key>.
+    void enableCache(size_t slots = 4096);
+    void disableCache();
+    bool hasCache() const;
+    void clear();
 protected:
+    virtual Node<Key, Value>* internalFind(const Key& key) const;
+    size_t cacheSlot(const Key& key) const;
+    void cacheForget(const Key& key);
+    void cacheFlush();
+    bool filterRejects(const Key& key) const;
+    void filterAdd(const Key& key);
+    void rebuildFilter(size_t capacity);
+
+    // balance of a node whose subtree a relaxed update has changed; every
+    // ancestor of such a node carries it too
+    static const int8_t dirty = 3;
+
     virtual void nodeSwap( AVLNode<Key,Value>* n1, AVLNode<Key,Value>* n2);
 
     // Add helper functions here
     AVLNode<Key, Value>* conversion(Node<Key, Value>* n) const; 
+    virtual Node<Key, Value>* cloneNode(const Node<Key, Value>* src, Node<Key, Value>* parent) const;
     void rightRotate(AVLNode<Key,Value>* n);
     void leftRotate(AVLNode<Key,Value>* n);
     void insertFix(AVLNode<Key, Value>* p, AVLNode<Key, Value>* n);
     void removeFix(AVLNode<Key, Value>* n, int8_t diff);  
+    void attachLeaf(AVLNode<Key, Value>* p, AVLNode<Key, Value>* n, bool left, size_t depth);
+    void removeNode(AVLNode<Key, Value>* removal);
+    void deferFix(AVLNode<Key, Value>* n, size_t depth);
+    static AVLNode<Key, Value>* repair(AVLNode<Key, Value>* n, int& h);
+
+    // Split/join helpers. These work on detached subtrees and take and return
+    // subtree heights alongside the roots so nothing is ever recomputed.
+    static int subtreeHeight(AVLNode<Key, Value>* n);
+    static AVLNode<Key, Value>* link(AVLNode<Key, Value>* l, AVLNode<Key, Value>* k, AVLNode<Key, Value>* r);
+    static AVLNode<Key, Value>* rebalanceAt(AVLNode<Key, Value>* n, int hl, int hr, int& h);
+    static AVLNode<Key, Value>* join(AVLNode<Key, Value>* l, int hl, AVLNode<Key, Value>* k,
+                                     AVLNode<Key, Value>* r, int hr, int& h);
+    static AVLNode<Key, Value>* join2(AVLNode<Key, Value>* l, int hl, AVLNode<Key, Value>* r, int hr, int& h);
+    static AVLNode<Key, Value>* splitLast(AVLNode<Key, Value>* n, int hn, AVLNode<Key, Value>*& last, int& h);
+    static void splitTree(AVLNode<Key, Value>* n, int hn, const Key& key,
+                          AVLNode<Key, Value>*& lower, int& hl, AVLNode<Key, Value>*& match,
+                          AVLNode<Key, Value>*& upper, int& hu);
+
+    // Divide and conquer set operation helpers. The two halves of each step
+    // touch disjoint nodes, so the top parallelDepth() levels fork their
+    // left half onto the shared WorkStealingPool.
+    static AVLNode<Key, Value>* unionOf(AVLNode<Key, Value>* a, int ha, AVLNode<Key, Value>* b, int hb,
+                                        bool bIsOther, int depth, int& h, size_t& freed);
+    static AVLNode<Key, Value>* intersectionOf(AVLNode<Key, Value>* a, int ha, AVLNode<Key, Value>* b, int hb,
+                                               bool aIsOurs, int depth, int& h, size_t& freed);
+    static AVLNode<Key, Value>* differenceOf(AVLNode<Key, Value>* a, int ha, AVLNode<Key, Value>* b, int hb,
+                                             int depth, int& h, size_t& freed);
+    static AVLNode<Key, Value>* insertSorted(AVLNode<Key, Value>* t, int ht, const std::pair<Key, Value>* items,
+                                             size_t count, char* added, int depth, int& h);
+    static AVLNode<Key, Value>* removeSorted(AVLNode<Key, Value>* t, int ht, const Key* keys,
+                                             size_t count, char* removed, int depth, int& h);
+
+    bool relaxed_;
+    size_t updateBudget_;
+    // updates deferred since the last rebalance
+    size_t deferred_;
+    CountingBloomFilter<Key>* filter_;
+    // empty while the cache is off; a power of two slots long otherwise
+    mutable std::vector<Node<Key, Value>*> cache_;
+    int cacheShift_;
 };
 
 
@@ -152,6 +275,94 @@ AVLNode<Key, Value> *AVLTree<Key, Value>::conversion(Node<Key, Value>* n) const
     return static_cast<AVLNode<Key, Value>*>(n);
 }
 
+template<class Key, class Value>
+AVLTree<Key, Value>::AVLTree() : BinarySearchTree<Key, Value>(),
+    relaxed_(false), updateBudget_(0), deferred_(0), filter_(NULL), cacheShift_(0)
+{
+
+}
+
+/*
+ * The copy has to be made here rather than in the base class copy
+ * constructor, since only now does cloneNode make AVLNodes.
+ */
+template<class Key, class Value>
+AVLTree<Key, Value>::AVLTree(const AVLTree<Key, Value>& other) : BinarySearchTree<Key, Value>(),
+    relaxed_(other.relaxed_), updateBudget_(other.updateBudget_), deferred_(other.deferred_), filter_(NULL),
+    cache_(other.cache_.size(), NULL), cacheShift_(other.cacheShift_)
+{
+    this->copyFrom(other);
+    if (other.filter_ != NULL) filter_ = new CountingBloomFilter<Key>(*other.filter_);
+}
+
+template<class Key, class Value>
+AVLTree<Key, Value>::AVLTree(AVLTree<Key, Value>&& other) :
+    BinarySearchTree<Key, Value>(std::move(other)),
+    relaxed_(other.relaxed_), updateBudget_(other.updateBudget_), deferred_(other.deferred_),
+    filter_(other.filter_), cache_(std::move(other.cache_)), cacheShift_(other.cacheShift_)
+{
+    other.deferred_ = 0;
+    other.filter_ = NULL;
+    other.cache_.clear();
+}
+
+template<class Key, class Value>
+AVLTree<Key, Value>::~AVLTree()
+{
+    delete filter_;
+}
+
+template<class Key, class Value>
+AVLTree<Key, Value>& AVLTree<Key, Value>::operator=(const AVLTree<Key, Value>& other)
+{
+    if (this != &other)
+    {
+      BinarySearchTree<Key, Value>::operator=(other);
+      relaxed_ = other.relaxed_;
+      updateBudget_ = other.updateBudget_;
+      deferred_ = other.deferred_;
+      delete filter_;
+      filter_ = (other.filter_ != NULL) ? new CountingBloomFilter<Key>(*other.filter_) : NULL;
+      cache_.assign(other.cache_.size(), NULL);
+      cacheShift_ = other.cacheShift_;
+    }
+    return *this;
+}
+
+template<class Key, class Value>
+AVLTree<Key, Value>& AVLTree<Key, Value>::operator=(AVLTree<Key, Value>&& other)
+{
+    if (this != &other)
+    {
+      // the base clears this tree first, which also clears our filter, so
+      // other's filter can only be taken after
+      BinarySearchTree<Key, Value>::operator=(std::move(other));
+      relaxed_ = other.relaxed_;
+      updateBudget_ = other.updateBudget_;
+      deferred_ = other.deferred_;
+      other.deferred_ = 0;
+      delete filter_;
+      filter_ = other.filter_;
+      other.filter_ = NULL;
+      cache_ = std::move(other.cache_);
+      cacheShift_ = other.cacheShift_;
+      other.cache_.clear();
+    }
+    return *this;
+}
+
+/*
+ * Copies a node along with its balance, so a copied tree needs no rebalancing.
+ */
+template<class Key, class Value>
+Node<Key, Value>* AVLTree<Key, Value>::cloneNode(const Node<Key, Value>* src, Node<Key, Value>* parent) const
+{
+    const AVLNode<Key, Value>* avlSrc = static_cast<const AVLNode<Key, Value>*>(src);
+    AVLNode<Key, Value>* n = new AVLNode<Key, Value>(src->getKey(), src->getValue(), conversion(parent));
+    n->setBalance(avlSrc->getBalance());
+    return n;
+}
+
 
 
 /*
@@ -168,12 +379,15 @@ void AVLTree<Key, Value>::insert (const std::pair<const Key, Value> &new_item)
       // std::cout << "empty tree and setting the root" << std::endl; 
       AVLNode<Key, Value>* newNode = new AVLNode<Key, Value>(new_item.first, new_item.second, NULL); 
       this->root_ = newNode; 
+      this->size_++; 
+      filterAdd(new_item.first);
     }
     else
     {
       // if there is something in the tree, we need to compare the keys
       // if less than go left, if greater than go right  
       AVLNode<Key, Value>* traveler = conversion(this->root_);
+      size_t depth = 1;
       
       while (traveler != NULL) 
       {
@@ -183,19 +397,11 @@ void AVLTree<Key, Value>::insert (const std::pair<const Key, Value> &new_item)
           // if there is nothing left, we create the node here and end the loop 
           if (traveler->getLeft() == NULL)
           {
-            AVLNode<Key, Value>* newNode = new AVLNode<Key, Value>(new_item.first, new_item.second, traveler);
-            traveler->setLeft(newNode);
-            // adding a left node, we must increase the balance of parent by -1 
-            if (traveler->getBalance() == -1) traveler->setBalance(0); 
-            else if (traveler->getBalance() == 1) traveler->setBalance(0);  
-            else if (traveler->getBalance() == 0) 
-            {
-              traveler->setBalance(-1); 
-              insertFix(traveler, newNode);
-            }
+            attachLeaf(traveler, new AVLNode<Key, Value>(new_item.first, new_item.second, traveler), true, depth);
             break; 
           }
           traveler = traveler->getLeft(); 
+          depth++;
         }
         // if key is the same, set the value 
         else if (traveler->getKey() == new_item.first)
@@ -208,24 +414,44 @@ void AVLTree<Key, Value>::insert (const std::pair<const Key, Value> &new_item)
         {
           if (traveler->getRight() == NULL)
           {
-            AVLNode<Key, Value>* newNode = new AVLNode<Key, Value>(new_item.first, new_item.second, traveler); 
-            traveler->setRight(newNode); 
-            // adding a right node, we must increase balance of parent by 1 
-            if (traveler->getBalance() == -1) traveler->setBalance(0); 
-            else if (traveler->getBalance() == 1) traveler->setBalance(0);  
-            else if (traveler->getBalance() == 0) 
-            {
-              traveler->setBalance(1); 
-              insertFix(traveler, newNode);
-            }
+            attachLeaf(traveler, new AVLNode<Key, Value>(new_item.first, new_item.second, traveler), false, depth);
             break;
           }
           traveler = traveler->getRight(); 
+          depth++;
         }
       }
     }
 }
 
+/*
+ * Hangs the new leaf n off p, depth levels below the root, and restores
+ * balance above it.
+ */
+template<class Key, class Value>
+void AVLTree<Key, Value>::attachLeaf(AVLNode<Key, Value>* p, AVLNode<Key, Value>* n, bool left, size_t depth)
+{
+    if (left) p->setLeft(n);
+    else p->setRight(n);
+    this->size_++;
+    filterAdd(n->getKey());
+    if (relaxed_)
+    {
+      deferFix(p, depth);
+      return;
+    }
+    // a parent that leaned either way is now even and its height is unchanged 
+    if (p->getBalance() != 0)
+    {
+      p->setBalance(0);
+    }
+    else
+    {
+      p->setBalance(left ? -1 : 1);
+      insertFix(p, n);
+    }
+}
+
 template<class Key, class Value>
 void AVLTree<Key, Value>::insertFix(AVLNode<Key, Value>* p, AVLNode<Key, Value>* n)
 {
@@ -324,165 +550,136 @@ void AVLTree<Key, Value>::insertFix(AVLNode<Key, Value>* p, AVLNode<Key, Value>*
 template<class Key, class Value>
 void AVLTree<Key, Value>:: remove(const Key& key)
 {
-     // find the value by walking the tree 
+    // find the value by walking the tree 
     AVLNode<Key, Value>* removal = conversion(this->internalFind(key)); 
-    int8_t diff = 0;
     // if the value is not found we stop 
     if (removal == NULL) return; 
-    // 0 child case --> left and right children are NULL
-    else if (removal->getRight() == NULL && removal->getLeft() == NULL)
+    removeNode(removal); 
+}
+
+/*
+ * Unlinks and frees the given node, then rebalances above it.
+ */
+template<class Key, class Value>
+void AVLTree<Key, Value>::removeNode(AVLNode<Key, Value>* removal)
+{
+    // 2 child case --> swap with the predecessor, which has at most a left child 
+    if (removal->getRight() != NULL && removal->getLeft() != NULL)
     {
-      if (removal == this->root_) 
-      {
-        this->root_ = NULL; 
-      }
+      nodeSwap(removal, conversion(this->predecessor(removal))); 
     }
-    // 2 child case --> left and right child are not NULL 
-    else if (removal->getRight() != NULL && removal->getLeft() != NULL)
+
+    // now removal has at most one child, which takes its place 
+    AVLNode<Key, Value>* child = removal->getLeft(); 
+    if (child == NULL) child = removal->getRight(); 
+    AVLNode<Key, Value>* p = removal->getParent(); 
+
+    // the side we remove from decides which way the parent's balance moves,
+    // so it has to be read before the parent is relinked 
+    int8_t diff = 0;
+    if (p == NULL)
     {
-      AVLNode<Key, Value>* temp = removal; 
-      temp = conversion(this->predecessor(removal)); 
-      // check if a predecessor exists
-      if (temp == NULL){}
-      else
-      {
-        nodeSwap(removal, temp); 
-        // if the root was what just got swapped, update it 
-        if (removal == this->root_)
-        {
-          this->root_ = temp; 
-        }
-          // do 0 child case with the swapped node 
-        if (removal->getRight() == NULL && removal->getLeft() == NULL)
-        {
-          // root is swapped out so we don't have to consider that case 
-          temp = removal->getParent(); 
-        }
-        // or do 1 child case with the swapped node 
-        else if (removal->getRight() != NULL || removal->getLeft() != NULL)
-        {
-          // if node has a right child 
-          if (removal->getRight() != NULL) 
-          {
-            if (removal == this->root_) 
-            {
-              this->root_ = removal->getRight(); 
-              this->root_ = NULL; 
-            }
-            // see whether the node is a left or right node 
-            else if (removal->getParent()->getRight() == removal)
-            {
-              // set the current node location to the right child 
-              AVLNode<Key, Value>* parent = removal->getParent(); 
-              parent->setRight(removal->getRight()); 
-              parent->getRight()->setParent(parent); 
-            }
-            else if (removal->getParent()->getLeft() == removal)
-            {
-              // set the current node location to the left child 
-              AVLNode<Key, Value>* parent = removal->getParent(); 
-              parent->setLeft(removal->getRight()); 
-              parent->getLeft()->setParent(parent); 
-            }
-            // delete removal; 
-          }
-          // if root has a left child  
-          else if (removal->getLeft() != NULL) 
-          {
-            // if the spot of removal is root we must update root value 
-            if (removal == this->root_) 
-            {
-              this->root_ = removal->getLeft(); 
-            }
-            // otherwise we check whether this is a left or right node and adjust the parent 
-            else if (removal->getParent()->getRight() == removal)
-            {
-              AVLNode<Key, Value>* parent = removal->getParent(); 
-              parent->setRight(removal->getLeft()); 
-              parent->getRight()->setParent(parent); 
-            }
-            else if (removal->getParent()->getLeft() == removal)
-            {
-              AVLNode<Key, Value>* parent = removal->getParent(); 
-              parent->setLeft(removal->getLeft()); 
-              parent->getLeft()->setParent(parent); 
-            }
-          }
-        }
-      }
+      this->root_ = child; 
     }
-    // 1 child case --> either the left or right child is NULL 
-    else if (removal->getRight() != NULL || removal->getLeft() != NULL)
+    else if (p->getLeft() == removal)
     {
-        // if node has a right child 
-        if (removal->getRight() != NULL) 
-        {
-          if (removal == this->root_) 
-          {
-            this->root_ = removal->getRight(); 
-            this->root_->setParent(NULL); 
-          }
-          // see whether the node is a left or right node 
-          else if (removal->getParent()->getRight() == removal)
-          {
-            // set the current node location to the right child 
-            AVLNode<Key, Value>* parent = removal->getParent(); 
-            parent->setRight(removal->getRight()); 
-            parent->getRight()->setParent(parent); 
-          }
-          else if (removal->getParent()->getLeft() == removal)
-          {
-            // set the current node location to the left child 
-            AVLNode<Key, Value>* parent = removal->getParent(); 
-            parent->setLeft(removal->getRight()); 
-            parent->getLeft()->setParent(parent); 
-          }
-        }
-        // if root has a left child  
-        else if (removal->getLeft() != NULL) 
-        {
-          // if the spot of removal is root we must update root value 
-          if (removal == this->root_) 
-          {
-            this->root_ = removal->getLeft(); 
-            this->root_->setParent(NULL); 
-          }
-          // otherwise we check whether this is a left or right node and adjust the parent 
-          else if (removal->getParent()->getRight() == removal)
-          {
-            AVLNode<Key, Value>* parent = removal->getParent(); 
-            parent->setRight(removal->getLeft()); 
-            parent->getRight()->setParent(parent); 
-          }
-          else if (removal->getParent()->getLeft() == removal)
-          {
-            AVLNode<Key, Value>* parent = removal->getParent(); 
-            parent->setLeft(removal->getLeft()); 
-            parent->getLeft()->setParent(parent); 
-          }
-        }
-      }
-
-      AVLNode<Key, Value>* p = removal->getParent(); 
-
-    if (p != NULL)
+      diff = 1; 
+      p->setLeft(child); 
+    }
+    else
     {
-        if (p->getLeft() == removal)
-        {
-            diff = 1;
-            p->setLeft(NULL);
-        }
-        if (p->getRight() == removal)
-        {
-            diff = -1; 
-            p->setRight(NULL); 
-        }
+      diff = -1; 
+      p->setRight(child); 
     }
-    
+    if (child != NULL) child->setParent(p); 
+
+    if (filter_ != NULL) filter_->remove(removal->getKey());
+    cacheForget(removal->getKey());
     delete removal; 
+    this->size_--; 
+    if (relaxed_)
+    {
+      if (p != NULL) deferFix(p, 0);
+      return;
+    }
     removeFix(p, diff); 
 }
 
+/*
+ * Records a relaxed update below n instead of fixing it: n and its
+ * ancestors are marked dirty, stopping at the first one already marked.
+ * depth is how deep an insert landed, 0 for a remove.
+ */
+template<class Key, class Value>
+void AVLTree<Key, Value>::deferFix(AVLNode<Key, Value>* n, size_t depth)
+{
+    while (n != NULL && n->getBalance() != dirty)
+    {
+      n->setBalance(dirty);
+      n = n->getParent();
+    }
+    deferred_++;
+
+    size_t log2Size = 0;
+    while ((size_t(2) << log2Size) <= this->size_) log2Size++;
+    if ((updateBudget_ != 0 && deferred_ >= updateBudget_) || depth > 2 * log2Size + 2)
+    {
+      rebalance();
+    }
+}
+
+template<class Key, class Value>
+void AVLTree<Key, Value>::setRelaxed(bool relaxed, size_t updateBudget)
+{
+    relaxed_ = relaxed;
+    updateBudget_ = updateBudget;
+    if (!relaxed) rebalance();
+}
+
+template<class Key, class Value>
+bool AVLTree<Key, Value>::isRelaxed() const
+{
+    return relaxed_;
+}
+
+/*
+ * Restores the AVL invariant after relaxed updates. Only dirty nodes are
+ * visited: each one is rejoined over its repaired subtrees, bottom up.
+ * Costs O(d log n) for d dirty nodes, and nothing when none are dirty.
+ */
+template<class Key, class Value>
+void AVLTree<Key, Value>::rebalance()
+{
+    deferred_ = 0;
+    AVLNode<Key, Value>* root = conversion(this->root_);
+    if (root == NULL || root->getBalance() != dirty) return;
+    int h;
+    this->root_ = repair(root, h);
+}
+
+/*
+ * Returns the subtree at n as a valid AVL tree, with its height in h. A
+ * clean subtree is returned as it is; a dirty node is joined back over its
+ * repaired children, which rotates away whatever imbalance piled up there.
+ * Recurses only through dirty nodes, which the depth limit on relaxed
+ * inserts keeps O(log n) deep.
+ */
+template<class Key, class Value>
+AVLNode<Key, Value>* AVLTree<Key, Value>::repair(AVLNode<Key, Value>* n, int& h)
+{
+    if (n == NULL || n->getBalance() != dirty)
+    {
+      h = subtreeHeight(n);
+      return n;
+    }
+    int hl, hr;
+    AVLNode<Key, Value>* l = repair(n->getLeft(), hl);
+    AVLNode<Key, Value>* r = repair(n->getRight(), hr);
+    if (l != NULL) l->setParent(NULL);
+    if (r != NULL) r->setParent(NULL);
+    return join(l, hl, n, r, hr, h);
+}
+
 template<class Key, class Value>
 void AVLTree<Key, Value>::removeFix(AVLNode<Key, Value>* n, int8_t diff)
 {
@@ -688,13 +885,1165 @@ void AVLTree<Key, Value>:: rightRotate(AVLNode<Key,Value>* n)
 
 }
 
+/*
+ * Attaches a filter sized for expectedKeys or the current size, whichever is
+ * larger, and loads the current keys into it.
+ */
 template<class Key, class Value>
-void AVLTree<Key, Value>::nodeSwap( AVLNode<Key,Value>* n1, AVLNode<Key,Value>* n2)
+void AVLTree<Key, Value>::enableFilter(size_t expectedKeys)
 {
-    BinarySearchTree<Key, Value>::nodeSwap(n1, n2);
-    int8_t tempB = n1->getBalance();
-    n1->setBalance(n2->getBalance());
-    n2->setBalance(tempB);
+    if (!FilterHash<Key>::available)
+    {
+      throw std::logic_error("AVLTree filter needs std::hash for the key type");
+    }
+    rebuildFilter(expectedKeys);
+}
+
+template<class Key, class Value>
+void AVLTree<Key, Value>::disableFilter()
+{
+    delete filter_;
+    filter_ = NULL;
+}
+
+template<class Key, class Value>
+bool AVLTree<Key, Value>::hasFilter() const
+{
+    return filter_ != NULL;
+}
+
+template<class Key, class Value>
+void AVLTree<Key, Value>::clear()
+{
+    BinarySearchTree<Key, Value>::clear();
+    if (filter_ != NULL) filter_->clear();
+    cacheFlush();
+}
+
+/*
+ * Lookups try the cache, then ask the filter and only descend on a
+ * probable hit. A node found by descending takes over its key's slot.
+ */
+template<class Key, class Value>
+Node<Key, Value>* AVLTree<Key, Value>::internalFind(const Key& key) const
+{
+    if (cache_.empty())
+    {
+      if (filterRejects(key)) return NULL;
+      return BinarySearchTree<Key, Value>::internalFind(key);
+    }
+    Node<Key, Value>*& entry = cache_[cacheSlot(key)];
+    if (entry != NULL && entry->getKey() == key) return entry;
+    if (filterRejects(key)) return NULL;
+    Node<Key, Value>* n = BinarySearchTree<Key, Value>::internalFind(key);
+    if (n != NULL) entry = n;
+    return n;
+}
+
+/*
+ * Sizes the cache to slots rounded up to a power of two, at least 64, and
+ * starts it empty.
+ */
+template<class Key, class Value>
+void AVLTree<Key, Value>::enableCache(size_t slots)
+{
+    if (!FilterHash<Key>::available)
+    {
+      throw std::logic_error("AVLTree cache needs std::hash for the key type");
+    }
+    int bits = 6;
+    while ((size_t(1) << bits) < slots) bits++;
+    cache_.assign(size_t(1) << bits, NULL);
+    cacheShift_ = 64 - bits;
+}
+
+template<class Key, class Value>
+void AVLTree<Key, Value>::disableCache()
+{
+    std::vector<Node<Key, Value>*>().swap(cache_);
+}
+
+template<class Key, class Value>
+bool AVLTree<Key, Value>::hasCache() const
+{
+    return !cache_.empty();
+}
+
+/*
+ * Multiplies the hash by 2^64 / phi and keeps the top bits, since
+ * std::hash is the identity for integers on most libraries and strided
+ * keys would otherwise share slots.
+ */
+template<class Key, class Value>
+size_t AVLTree<Key, Value>::cacheSlot(const Key& key) const
+{
+    return (size_t)(((uint64_t)FilterHash<Key>::hash(key) * 0x9E3779B97F4A7C15ull) >> cacheShift_);
+}
+
+/*
+ * Drops the entry for key before its node is freed. The slot is emptied
+ * without reading the node in it, so this is safe after the free as well.
+ */
+template<class Key, class Value>
+void AVLTree<Key, Value>::cacheForget(const Key& key)
+{
+    if (!cache_.empty()) cache_[cacheSlot(key)] = NULL;
+}
+
+/*
+ * Empties every slot, for bulk operations that free or move nodes.
+ */
+template<class Key, class Value>
+void AVLTree<Key, Value>::cacheFlush()
+{
+    std::fill(cache_.begin(), cache_.end(), (Node<Key, Value>*)NULL);
+}
+
+// how many descents find_many interleaves
+#define AVL_FIND_LANES 16
+
+#if defined(__GNUC__)
+#define AVL_PREFETCH(p) __builtin_prefetch(p)
+#else
+#define AVL_PREFETCH(p) ((void)(p))
+#endif
+
+/*
+ * Each lane holds one descent. A round moves every lane one level down and
+ * prefetches the node it lands on, which is not read until the next round,
+ * by when the other lanes' loads have had their turn. A lane that finishes
+ * takes the next key, so the lanes stay full to the end of the batch.
+ */
+template<class Key, class Value>
+void AVLTree<Key, Value>::find_many(const std::vector<Key>& keys,
+                                   std::vector<typename BinarySearchTree<Key, Value>::iterator>& out) const
+{
+    out.assign(keys.size(), this->end());
+    Node<Key, Value>* at[AVL_FIND_LANES];
+    size_t index[AVL_FIND_LANES];
+    size_t active = 0;
+    size_t next = 0;
+    while (true)
+    {
+      while (active < AVL_FIND_LANES && next < keys.size())
+      {
+        if (this->root_ != NULL && !filterRejects(keys[next]))
+        {
+          at[active] = this->root_;
+          index[active] = next;
+          active++;
+        }
+        next++;
+      }
+      if (active == 0) return;
+
+      for (size_t lane = 0; lane < active; )
+      {
+        Node<Key, Value>* n = at[lane];
+        const Key& key = keys[index[lane]];
+        if (key < n->getKey()) n = n->getLeft();
+        else if (n->getKey() < key) n = n->getRight();
+        else
+        {
+          out[index[lane]] = this->iteratorAt(n);
+          n = NULL;
+        }
+        if (n == NULL)
+        {
+          // the lane is done; the last one takes its place
+          active--;
+          at[lane] = at[active];
+          index[lane] = index[active];
+          continue;
+        }
+        AVL_PREFETCH(n);
+        at[lane] = n;
+        lane++;
+      }
+    }
+}
+
+template<class Key, class Value>
+bool AVLTree<Key, Value>::filterRejects(const Key& key) const
+{
+    return filter_ != NULL && !filter_->mayContain(key);
+}
+
+/*
+ * Records a new key in the filter, doubling the filter once the tree
+ * outgrows it so the false positive rate stays put.
+ */
+template<class Key, class Value>
+void AVLTree<Key, Value>::filterAdd(const Key& key)
+{
+    if (filter_ == NULL) return;
+    if (this->size_ > filter_->capacity()) rebuildFilter(2 * this->size_);
+    else filter_->add(key);
+}
+
+/*
+ * Replaces the filter with one sized for at least capacity keys holding
+ * every key in the tree. O(n).
+ */
+template<class Key, class Value>
+void AVLTree<Key, Value>::rebuildFilter(size_t capacity)
+{
+    CountingBloomFilter<Key>* rebuilt = new CountingBloomFilter<Key>(std::max(capacity, this->size_));
+    for (typename BinarySearchTree<Key, Value>::iterator it = this->begin(); it != this->end(); ++it)
+    {
+      rebuilt->add(it->first);
+    }
+    delete filter_;
+    filter_ = rebuilt;
+}
+
+/*
+ * Moves every key at or above key into the returned tree, which inherits
+ * this tree's relaxed and filter settings. Our filter keeps the moved keys,
+ * which only costs false positives until it is next rebuilt.
+ */
+template<class Key, class Value>
+AVLTree<Key, Value> AVLTree<Key, Value>::splitOff(const Key& key)
+{
+    AVLTree<Key, Value> result;
+    result.relaxed_ = relaxed_;
+    result.updateBudget_ = updateBudget_;
+    result.cache_.assign(cache_.size(), NULL);
+    result.cacheShift_ = cacheShift_;
+    if (this->root_ != NULL)
+    {
+      rebalance();
+      AVLNode<Key, Value>* lower; AVLNode<Key, Value>* match; AVLNode<Key, Value>* upper;
+      int hl, hu, h;
+      AVLNode<Key, Value>* root = conversion(this->root_);
+      splitTree(root, subtreeHeight(root), key, lower, hl, match, upper, hu);
+      if (match != NULL) upper = join(NULL, 0, match, upper, hu, h);
+      this->root_ = lower;
+      result.root_ = upper;
+      result.size_ = this->countNodes(upper);
+      this->size_ -= result.size_;
+    }
+    if (filter_ != NULL) result.rebuildFilter(0);
+    cacheFlush();
+    return result;
+}
+
+/*
+ * Appends other, every one of whose keys must be greater than every key
+ * here, and leaves other empty.
+ */
+template<class Key, class Value>
+void AVLTree<Key, Value>::concat(AVLTree<Key, Value>& other)
+{
+    if (&other == this || other.root_ == NULL) return;
+    if (this->root_ != NULL)
+    {
+      Node<Key, Value>* largest = this->root_;
+      while (largest->getRight() != NULL) largest = largest->getRight();
+      if (!(largest->getKey() < other.getSmallestNode()->getKey()))
+      {
+        throw std::invalid_argument("AVLTrees to concatenate overlap");
+      }
+    }
+    rebalance();
+    other.rebalance();
+    if (filter_ != NULL)
+    {
+      for (typename BinarySearchTree<Key, Value>::iterator it = other.begin(); it != other.end(); ++it)
+      {
+        filter_->add(it->first);
+      }
+    }
+    AVLNode<Key, Value>* a = conversion(this->root_);
+    AVLNode<Key, Value>* b = conversion(other.root_);
+    int h;
+    this->root_ = join2(a, subtreeHeight(a), b, subtreeHeight(b), h);
+    this->size_ += other.size_;
+    other.root_ = NULL;
+    other.size_ = 0;
+    if (other.filter_ != NULL) other.filter_->clear();
+    other.cacheFlush();
+    if (filter_ != NULL && this->size_ > filter_->capacity()) rebuildFilter(2 * this->size_);
+}
+
+/*
+ * Inserts or overwrites every pair in [first, last). The batch is sorted,
+ * equal keys are folded into their last pair, and the sorted run is merged
+ * into the tree by insertSorted. Nodes already in the tree keep their place
+ * and only take the new value.
+ */
+template<class Key, class Value>
+template<class InputIt>
+void AVLTree<Key, Value>::insert_batch(InputIt first, InputIt last)
+{
+    std::vector<std::pair<Key, Value> > items;
+    for (; first != last; ++first) items.push_back(std::pair<Key, Value>(first->first, first->second));
+    if (items.empty()) return;
+    std::stable_sort(items.begin(), items.end(),
+                     [](const std::pair<Key, Value>& a, const std::pair<Key, Value>& b) { return a.first < b.first; });
+    size_t kept = 0;
+    for (size_t i = 0; i < items.size(); ++i)
+    {
+      if (i + 1 < items.size() && !(items[i].first < items[i + 1].first)) continue;
+      if (kept != i) items[kept] = std::move(items[i]);
+      kept++;
+    }
+    items.erase(items.begin() + kept, items.end());
+
+    // splitting reads heights off the balances
+    rebalance();
+    std::vector<char> added(items.size(), 0);
+    AVLNode<Key, Value>* root = conversion(this->root_);
+    int h;
+    this->root_ = insertSorted(root, subtreeHeight(root), &items[0], items.size(), &added[0], 0, h);
+    for (size_t i = 0; i < items.size(); ++i)
+    {
+      if (!added[i]) continue;
+      this->size_++;
+      if (filter_ != NULL) filter_->add(items[i].first);
+    }
+    if (filter_ != NULL && this->size_ > filter_->capacity()) rebuildFilter(2 * this->size_);
+}
+
+/*
+ * Removes every key in [first, last) that is in the tree.
+ */
+template<class Key, class Value>
+template<class InputIt>
+void AVLTree<Key, Value>::remove_batch(InputIt first, InputIt last)
+{
+    std::vector<Key> keys(first, last);
+    if (keys.empty() || this->root_ == NULL) return;
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end(),
+                           [](const Key& a, const Key& b) { return !(a < b) && !(b < a); }), keys.end());
+
+    rebalance();
+    std::vector<char> removed(keys.size(), 0);
+    AVLNode<Key, Value>* root = conversion(this->root_);
+    int h;
+    this->root_ = removeSorted(root, subtreeHeight(root), &keys[0], keys.size(), &removed[0], 0, h);
+    for (size_t i = 0; i < keys.size(); ++i)
+    {
+      if (!removed[i]) continue;
+      this->size_--;
+      if (filter_ != NULL) filter_->remove(keys[i]);
+      cacheForget(keys[i]);
+    }
+}
+
+/*
+ * Removes every key k with lo <= k <= hi. The tree is split at lo and at hi,
+ * the middle piece is freed in one sweep, and the outer pieces are joined
+ * back together, so the rebalancing happens once along the seam instead of
+ * once per removed key. O(log n + k).
+ */
+template<class Key, class Value>
+void AVLTree<Key, Value>::erase(const Key& lo, const Key& hi)
+{
+    if (this->root_ == NULL || hi < lo) return;
+    // splitting reads heights off the balances
+    rebalance();
+    if (filter_ != NULL)
+    {
+      // the range is freed wholesale below, so take its keys out first
+      Node<Key, Value>* first = NULL;
+      for (Node<Key, Value>* n = this->root_; n != NULL; )
+      {
+        if (n->getKey() < lo) n = n->getRight();
+        else
+        {
+          first = n;
+          n = n->getLeft();
+        }
+      }
+      for (Node<Key, Value>* n = first; n != NULL && !(hi < n->getKey()); this->successor(n))
+      {
+        filter_->remove(n->getKey());
+      }
+    }
+
+    AVLNode<Key, Value>* lower; AVLNode<Key, Value>* first; AVLNode<Key, Value>* rest;
+    AVLNode<Key, Value>* range; AVLNode<Key, Value>* last; AVLNode<Key, Value>* upper;
+    int hLower, hRest, hRange, hUpper, h;
+    AVLNode<Key, Value>* root = conversion(this->root_);
+    splitTree(root, subtreeHeight(root), lo, lower, hLower, first, rest, hRest);
+    splitTree(rest, hRest, hi, range, hRange, last, upper, hUpper);
+
+    this->size_ -= this->destroySubtree(range) + (first != NULL) + (last != NULL);
+    cacheFlush();
+    delete first;
+    delete last;
+    this->root_ = join2(lower, hLower, upper, hUpper, h);
+}
+
+/*
+ * Height of an AVL subtree, found by following the taller child down.
+ */
+template<class Key, class Value>
+int AVLTree<Key, Value>::subtreeHeight(AVLNode<Key, Value>* n)
+{
+  int h = 0;
+  while (n != NULL)
+  {
+    h++;
+    n = (n->getBalance() < 0) ? n->getLeft() : n->getRight();
+  }
+  return h;
+}
+
+/*
+ * Makes l and r the children of k and returns k.
+ */
+template<class Key, class Value>
+AVLNode<Key, Value>* AVLTree<Key, Value>::link(AVLNode<Key, Value>* l, AVLNode<Key, Value>* k, AVLNode<Key, Value>* r)
+{
+  k->setLeft(l);
+  k->setRight(r);
+  if (l != NULL) l->setParent(k);
+  if (r != NULL) r->setParent(k);
+  return k;
+}
+
+/*
+ * n's children are AVL trees of heights hl and hr, which differ by at most 2.
+ * Sets n's balance, rotates if the heights differ by 2, and returns the new
+ * root of the subtree with its height in h. The returned root's parent is
+ * left for the caller to set.
+ */
+template<class Key, class Value>
+AVLNode<Key, Value>* AVLTree<Key, Value>::rebalanceAt(AVLNode<Key, Value>* n, int hl, int hr, int& h)
+{
+  if (hr - hl <= 1 && hl - hr <= 1)
+  {
+    n->setBalance(hr - hl);
+    h = std::max(hl, hr) + 1;
+    return n;
+  }
+  if (hr > hl)
+  {
+    AVLNode<Key, Value>* c = n->getRight();
+    int hcl = (c->getBalance() <= 0) ? hr - 1 : hr - 2;
+    int hcr = (c->getBalance() >= 0) ? hr - 1 : hr - 2;
+    // zig zig case 
+    if (c->getBalance() >= 0)
+    {
+      link(n->getLeft(), n, c->getLeft());
+      n->setBalance(hcl - hl);
+      int hn = std::max(hl, hcl) + 1;
+      link(n, c, c->getRight());
+      c->setBalance(hcr - hn);
+      h = std::max(hn, hcr) + 1;
+      return c;
+    }
+    // zig zag case 
+    AVLNode<Key, Value>* g = c->getLeft();
+    int hgl = (g->getBalance() <= 0) ? hcl - 1 : hcl - 2;
+    int hgr = (g->getBalance() >= 0) ? hcl - 1 : hcl - 2;
+    link(n->getLeft(), n, g->getLeft());
+    n->setBalance(hgl - hl);
+    int hn = std::max(hl, hgl) + 1;
+    link(g->getRight(), c, c->getRight());
+    c->setBalance(hcr - hgr);
+    int hc = std::max(hgr, hcr) + 1;
+    link(n, g, c);
+    g->setBalance(hc - hn);
+    h = std::max(hn, hc) + 1;
+    return g;
+  }
+  // this is the mirror case 
+  AVLNode<Key, Value>* c = n->getLeft();
+  int hcl = (c->getBalance() <= 0) ? hl - 1 : hl - 2;
+  int hcr = (c->getBalance() >= 0) ? hl - 1 : hl - 2;
+  if (c->getBalance() <= 0)
+  {
+    link(c->getRight(), n, n->getRight());
+    n->setBalance(hr - hcr);
+    int hn = std::max(hcr, hr) + 1;
+    link(c->getLeft(), c, n);
+    c->setBalance(hn - hcl);
+    h = std::max(hcl, hn) + 1;
+    return c;
+  }
+  AVLNode<Key, Value>* g = c->getRight();
+  int hgl = (g->getBalance() <= 0) ? hcr - 1 : hcr - 2;
+  int hgr = (g->getBalance() >= 0) ? hcr - 1 : hcr - 2;
+  link(g->getRight(), n, n->getRight());
+  n->setBalance(hr - hgr);
+  int hn = std::max(hgr, hr) + 1;
+  link(c->getLeft(), c, g->getLeft());
+  c->setBalance(hgl - hcl);
+  int hc = std::max(hcl, hgl) + 1;
+  link(c, g, n);
+  g->setBalance(hn - hc);
+  h = std::max(hc, hn) + 1;
+  return g;
+}
+
+/*
+ * Joins the AVL trees l and r (every key of l below k's, every key of r above)
+ * with k in between. Descends the spine of the taller tree to where the
+ * shorter one fits and rebalances on the way back up. O(|hl - hr| + 1).
+ */
+template<class Key, class Value>
+AVLNode<Key, Value>* AVLTree<Key, Value>::join(AVLNode<Key, Value>* l, int hl, AVLNode<Key, Value>* k,
+                                              AVLNode<Key, Value>* r, int hr, int& h)
+{
+  AVLNode<Key, Value>* root;
+  if (hl > hr + 1)
+  {
+    int hll = (l->getBalance() <= 0) ? hl - 1 : hl - 2;
+    int hlr = (l->getBalance() >= 0) ? hl - 1 : hl - 2;
+    int ht;
+    AVLNode<Key, Value>* t = join(l->getRight(), hlr, k, r, hr, ht);
+    link(l->getLeft(), l, t);
+    root = rebalanceAt(l, hll, ht, h);
+  }
+  else if (hr > hl + 1)
+  {
+    int hrl = (r->getBalance() <= 0) ? hr - 1 : hr - 2;
+    int hrr = (r->getBalance() >= 0) ? hr - 1 : hr - 2;
+    int ht;
+    AVLNode<Key, Value>* t = join(l, hl, k, r->getLeft(), hrl, ht);
+    link(t, r, r->getRight());
+    root = rebalanceAt(r, ht, hrr, h);
+  }
+  else
+  {
+    root = link(l, k, r);
+    k->setBalance(hr - hl);
+    h = std::max(hl, hr) + 1;
+  }
+  root->setParent(NULL);
+  return root;
+}
+
+/*
+ * Joins l and r (every key of l below every key of r) without a middle node,
+ * by splitting the largest node off l and using it as the middle.
+ */
+template<class Key, class Value>
+AVLNode<Key, Value>* AVLTree<Key, Value>::join2(AVLNode<Key, Value>* l, int hl, AVLNode<Key, Value>* r, int hr, int& h)
+{
+  if (l == NULL)
+  {
+    h = hr;
+    if (r != NULL) r->setParent(NULL);
+    return r;
+  }
+  AVLNode<Key, Value>* k;
+  int hrest;
+  AVLNode<Key, Value>* rest = splitLast(l, hl, k, hrest);
+  return join(rest, hrest, k, r, hr, h);
+}
+
+/*
+ * Detaches the largest node of the subtree at n into last and returns the
+ * remaining tree with its height in h.
+ */
+template<class Key, class Value>
+AVLNode<Key, Value>* AVLTree<Key, Value>::splitLast(AVLNode<Key, Value>* n, int hn, AVLNode<Key, Value>*& last, int& h)
+{
+  int hl = (n->getBalance() <= 0) ? hn - 1 : hn - 2;
+  int hr = (n->getBalance() >= 0) ? hn - 1 : hn - 2;
+  if (n->getRight() == NULL)
+  {
+    AVLNode<Key, Value>* l = n->getLeft();
+    if (l != NULL) l->setParent(NULL);
+    last = n;
+    link(NULL, n, NULL);
+    n->setBalance(0);
+    h = hl;
+    return l;
+  }
+  int hrest;
+  AVLNode<Key, Value>* rest = splitLast(n->getRight(), hr, last, hrest);
+  return join(n->getLeft(), hl, n, rest, hrest, h);
+}
+
+/*
+ * Splits the subtree at n (of height hn) into the keys below key, the node
+ * holding key itself (NULL if absent), and the keys above key. Every piece
+ * is a detached AVL tree. O(log n).
+ */
+template<class Key, class Value>
+void AVLTree<Key, Value>::splitTree(AVLNode<Key, Value>* n, int hn, const Key& key,
+                                    AVLNode<Key, Value>*& lower, int& hl, AVLNode<Key, Value>*& match,
+                                    AVLNode<Key, Value>*& upper, int& hu)
+{
+  if (n == NULL)
+  {
+    lower = upper = match = NULL;
+    hl = hu = 0;
+    return;
+  }
+  AVLNode<Key, Value>* left = n->getLeft();
+  AVLNode<Key, Value>* right = n->getRight();
+  int hnl = (n->getBalance() <= 0) ? hn - 1 : hn - 2;
+  int hnr = (n->getBalance() >= 0) ? hn - 1 : hn - 2;
+  if (left != NULL) left->setParent(NULL);
+  if (right != NULL) right->setParent(NULL);
+
+  if (key < n->getKey())
+  {
+    AVLNode<Key, Value>* mid;
+    int hmid;
+    splitTree(left, hnl, key, lower, hl, match, mid, hmid);
+    upper = join(mid, hmid, n, right, hnr, hu);
+  }
+  else if (n->getKey() < key)
+  {
+    AVLNode<Key, Value>* mid;
+    int hmid;
+    splitTree(right, hnr, key, mid, hmid, match, upper, hu);
+    lower = join(left, hnl, n, mid, hmid, hl);
+  }
+  else
+  {
+    lower = left;
+    hl = hnl;
+    upper = right;
+    hu = hnr;
+    match = link(NULL, n, NULL);
+    n->setParent(NULL);
+    n->setBalance(0);
+  }
+}
+
+/*
+ * Merges every key of other into this tree.
+ */
+template<class Key, class Value>
+void AVLTree<Key, Value>::unionWith(AVLTree<Key, Value>& other)
+{
+    if (&other == this) return;
+    rebalance();
+    other.rebalance();
+    AVLNode<Key, Value>* a = conversion(this->root_);
+    AVLNode<Key, Value>* b = conversion(other.root_);
+    size_t total = this->size_ + other.size_;
+    other.root_ = NULL;
+    other.size_ = 0;
+    int h;
+    size_t freed = 0;
+    this->root_ = unionOf(a, subtreeHeight(a), b, subtreeHeight(b), true, 0, h, freed);
+    this->size_ = total - freed;
+    if (filter_ != NULL) rebuildFilter(0);
+    if (other.filter_ != NULL) other.filter_->clear();
+    cacheFlush();
+    other.cacheFlush();
+}
+
+/*
+ * Keeps only the keys that are also in other.
+ */
+template<class Key, class Value>
+void AVLTree<Key, Value>::intersect(AVLTree<Key, Value>& other)
+{
+    if (&other == this) return;
+    rebalance();
+    other.rebalance();
+    AVLNode<Key, Value>* a = conversion(this->root_);
+    AVLNode<Key, Value>* b = conversion(other.root_);
+    size_t total = this->size_ + other.size_;
+    other.root_ = NULL;
+    other.size_ = 0;
+    int h;
+    size_t freed = 0;
+    this->root_ = intersectionOf(a, subtreeHeight(a), b, subtreeHeight(b), true, 0, h, freed);
+    this->size_ = total - freed;
+    if (filter_ != NULL) rebuildFilter(0);
+    if (other.filter_ != NULL) other.filter_->clear();
+    cacheFlush();
+    other.cacheFlush();
+}
+
+/*
+ * Removes every key that is in other.
+ */
+template<class Key, class Value>
+void AVLTree<Key, Value>::difference(AVLTree<Key, Value>& other)
+{
+    if (&other == this)
+    {
+      this->clear();
+      return;
+    }
+    rebalance();
+    other.rebalance();
+    AVLNode<Key, Value>* a = conversion(this->root_);
+    AVLNode<Key, Value>* b = conversion(other.root_);
+    size_t total = this->size_ + other.size_;
+    other.root_ = NULL;
+    other.size_ = 0;
+    int h;
+    size_t freed = 0;
+    this->root_ = differenceOf(a, subtreeHeight(a), b, subtreeHeight(b), 0, h, freed);
+    this->size_ = total - freed;
+    if (filter_ != NULL) rebuildFilter(0);
+    if (other.filter_ != NULL) other.filter_->clear();
+    cacheFlush();
+    other.cacheFlush();
+}
+
+// subtrees shorter than this (a few thousand nodes) are not worth a task
+#define AVL_PARALLEL_MIN_HEIGHT 12
+// nor are batches smaller than this
+#define AVL_PARALLEL_MIN_BATCH 4096
+
+/*
+ * Union of a and b. The taller tree's root is the pivot; the other tree is
+ * split by its key and the halves are merged on either side of it.
+ * bIsOther says whether b came from the other tree, whose values win.
+ */
+template<class Key, class Value>
+AVLNode<Key, Value>* AVLTree<Key, Value>::unionOf(AVLNode<Key, Value>* a, int ha, AVLNode<Key, Value>* b, int hb,
+                                                 bool bIsOther, int depth, int& h, size_t& freed)
+{
+  if (ha < hb) return unionOf(b, hb, a, ha, !bIsOther, depth, h, freed);
+  if (b == NULL)
+  {
+    h = ha;
+    if (a != NULL) a->setParent(NULL);
+    return a;
+  }
+
+  AVLNode<Key, Value>* bl; AVLNode<Key, Value>* m; AVLNode<Key, Value>* br;
+  int hbl, hbr;
+  splitTree(b, hb, a->getKey(), bl, hbl, m, br, hbr);
+  if (m != NULL)
+  {
+    if (bIsOther) a->setValue(m->getValue());
+    delete m;
+    freed++;
+  }
+
+  AVLNode<Key, Value>* al = a->getLeft();
+  AVLNode<Key, Value>* ar = a->getRight();
+  int hal = (a->getBalance() <= 0) ? ha - 1 : ha - 2;
+  int har = (a->getBalance() >= 0) ? ha - 1 : ha - 2;
+  if (al != NULL) al->setParent(NULL);
+  if (ar != NULL) ar->setParent(NULL);
+
+  int hl, hr;
+  AVLNode<Key, Value>* l;
+  AVLNode<Key, Value>* r;
+  if (depth < BinarySearchTree<Key, Value>::parallelDepth() && std::min(ha, hb) >= AVL_PARALLEL_MIN_HEIGHT)
+  {
+    size_t leftFreed = 0;
+    TaskGroup group(WorkStealingPool::shared());
+    group.spawn([&]() { l = unionOf(al, hal, bl, hbl, bIsOther, depth + 1, hl, leftFreed); });
+    r = unionOf(ar, har, br, hbr, bIsOther, depth + 1, hr, freed);
+    group.wait();
+    freed += leftFreed;
+  }
+  else
+  {
+    l = unionOf(al, hal, bl, hbl, bIsOther, depth + 1, hl, freed);
+    r = unionOf(ar, har, br, hbr, bIsOther, depth + 1, hr, freed);
+  }
+  return join(l, hl, a, r, hr, h);
+}
+
+/*
+ * Intersection of a and b. aIsOurs says whether a came from this tree,
+ * whose node is the one kept for a key found in both.
+ */
+template<class Key, class Value>
+AVLNode<Key, Value>* AVLTree<Key, Value>::intersectionOf(AVLNode<Key, Value>* a, int ha, AVLNode<Key, Value>* b, int hb,
+                                                        bool aIsOurs, int depth, int& h, size_t& freed)
+{
+  if (ha < hb) return intersectionOf(b, hb, a, ha, !aIsOurs, depth, h, freed);
+  if (b == NULL)
+  {
+    freed += BinarySearchTree<Key, Value>::destroySubtree(a);
+    h = 0;
+    return NULL;
+  }
+
+  AVLNode<Key, Value>* bl; AVLNode<Key, Value>* m; AVLNode<Key, Value>* br;
+  int hbl, hbr;
+  splitTree(b, hb, a->getKey(), bl, hbl, m, br, hbr);
+
+  AVLNode<Key, Value>* al = a->getLeft();
+  AVLNode<Key, Value>* ar = a->getRight();
+  int hal = (a->getBalance() <= 0) ? ha - 1 : ha - 2;
+  int har = (a->getBalance() >= 0) ? ha - 1 : ha - 2;
+  if (al != NULL) al->setParent(NULL);
+  if (ar != NULL) ar->setParent(NULL);
+  link(NULL, a, NULL);
+  a->setParent(NULL);
+
+  int hl, hr;
+  AVLNode<Key, Value>* l;
+  AVLNode<Key, Value>* r;
+  if (depth < BinarySearchTree<Key, Value>::parallelDepth() && std::min(ha, hb) >= AVL_PARALLEL_MIN_HEIGHT)
+  {
+    size_t leftFreed = 0;
+    TaskGroup group(WorkStealingPool::shared());
+    group.spawn([&]() { l = intersectionOf(al, hal, bl, hbl, aIsOurs, depth + 1, hl, leftFreed); });
+    r = intersectionOf(ar, har, br, hbr, aIsOurs, depth + 1, hr, freed);
+    group.wait();
+    freed += leftFreed;
+  }
+  else
+  {
+    l = intersectionOf(al, hal, bl, hbl, aIsOurs, depth + 1, hl, freed);
+    r = intersectionOf(ar, har, br, hbr, aIsOurs, depth + 1, hr, freed);
+  }
+
+  if (m == NULL)
+  {
+    delete a;
+    freed++;
+    return join2(l, hl, r, hr, h);
+  }
+  freed++;
+  if (aIsOurs)
+  {
+    delete m;
+    return join(l, hl, a, r, hr, h);
+  }
+  delete a;
+  return join(l, hl, m, r, hr, h);
+}
+
+/*
+ * The keys of a that are not in b. a is split by b's root key, and the
+ * halves are reduced by b's subtrees.
+ */
+template<class Key, class Value>
+AVLNode<Key, Value>* AVLTree<Key, Value>::differenceOf(AVLNode<Key, Value>* a, int ha, AVLNode<Key, Value>* b, int hb,
+                                                      int depth, int& h, size_t& freed)
+{
+  if (a == NULL)
+  {
+    freed += BinarySearchTree<Key, Value>::destroySubtree(b);
+    h = 0;
+    return NULL;
+  }
+  if (b == NULL)
+  {
+    h = ha;
+    a->setParent(NULL);
+    return a;
+  }
+
+  AVLNode<Key, Value>* al; AVLNode<Key, Value>* m; AVLNode<Key, Value>* ar;
+  int hal, har;
+  splitTree(a, ha, b->getKey(), al, hal, m, ar, har);
+  freed += (m != NULL);
+  delete m;
+
+  AVLNode<Key, Value>* bl = b->getLeft();
+  AVLNode<Key, Value>* br = b->getRight();
+  int hbl = (b->getBalance() <= 0) ? hb - 1 : hb - 2;
+  int hbr = (b->getBalance() >= 0) ? hb - 1 : hb - 2;
+  if (bl != NULL) bl->setParent(NULL);
+  if (br != NULL) br->setParent(NULL);
+  delete b;
+  freed++;
+
+  int hl, hr;
+  AVLNode<Key, Value>* l;
+  AVLNode<Key, Value>* r;
+  if (depth < BinarySearchTree<Key, Value>::parallelDepth() && std::min(ha, hb) >= AVL_PARALLEL_MIN_HEIGHT)
+  {
+    size_t leftFreed = 0;
+    TaskGroup group(WorkStealingPool::shared());
+    group.spawn([&]() { l = differenceOf(al, hal, bl, hbl, depth + 1, hl, leftFreed); });
+    r = differenceOf(ar, har, br, hbr, depth + 1, hr, freed);
+    group.wait();
+    freed += leftFreed;
+  }
+  else
+  {
+    l = differenceOf(al, hal, bl, hbl, depth + 1, hl, freed);
+    r = differenceOf(ar, har, br, hbr, depth + 1, hr, freed);
+  }
+  return join2(l, hl, r, hr, h);
+}
+
+/*
+ * Merges the sorted, distinct items into the subtree at t. The middle item
+ * splits t; it becomes the root of the result, reusing t's node for its key
+ * if there is one, and each half of the batch goes into its half of t.
+ * Items that needed a new node are flagged in added.
+ */
+template<class Key, class Value>
+AVLNode<Key, Value>* AVLTree<Key, Value>::insertSorted(AVLNode<Key, Value>* t, int ht, const std::pair<Key, Value>* items,
+                                                      size_t count, char* added, int depth, int& h)
+{
+  if (count == 0)
+  {
+    h = ht;
+    if (t != NULL) t->setParent(NULL);
+    return t;
+  }
+  size_t mid = count / 2;
+  AVLNode<Key, Value>* lower; AVLNode<Key, Value>* match; AVLNode<Key, Value>* upper;
+  int hlower, hupper;
+  splitTree(t, ht, items[mid].first, lower, hlower, match, upper, hupper);
+  if (match != NULL) match->setValue(items[mid].second);
+  else
+  {
+    match = new AVLNode<Key, Value>(items[mid].first, items[mid].second, NULL);
+    added[mid] = 1;
+  }
+
+  int hl, hr;
+  AVLNode<Key, Value>* l;
+  AVLNode<Key, Value>* r;
+  if (depth < BinarySearchTree<Key, Value>::parallelDepth() && count >= AVL_PARALLEL_MIN_BATCH)
+  {
+    TaskGroup group(WorkStealingPool::shared());
+    group.spawn([&]() { l = insertSorted(lower, hlower, items, mid, added, depth + 1, hl); });
+    r = insertSorted(upper, hupper, items + mid + 1, count - mid - 1, added + mid + 1, depth + 1, hr);
+    group.wait();
+  }
+  else
+  {
+    l = insertSorted(lower, hlower, items, mid, added, depth + 1, hl);
+    r = insertSorted(upper, hupper, items + mid + 1, count - mid - 1, added + mid + 1, depth + 1, hr);
+  }
+  return join(l, hl, match, r, hr, h);
+}
+
+/*
+ * Takes the sorted, distinct keys out of the subtree at t, flagging in
+ * removed the ones that were there. An empty piece of the tree ends the
+ * descent however many keys are left for it.
+ */
+template<class Key, class Value>
+AVLNode<Key, Value>* AVLTree<Key, Value>::removeSorted(AVLNode<Key, Value>* t, int ht, const Key* keys,
+                                                      size_t count, char* removed, int depth, int& h)
+{
+  if (count == 0 || t == NULL)
+  {
+    h = ht;
+    if (t != NULL) t->setParent(NULL);
+    return t;
+  }
+  size_t mid = count / 2;
+  AVLNode<Key, Value>* lower; AVLNode<Key, Value>* match; AVLNode<Key, Value>* upper;
+  int hlower, hupper;
+  splitTree(t, ht, keys[mid], lower, hlower, match, upper, hupper);
+  if (match != NULL)
+  {
+    delete match;
+    removed[mid] = 1;
+  }
+
+  int hl, hr;
+  AVLNode<Key, Value>* l;
+  AVLNode<Key, Value>* r;
+  if (depth < BinarySearchTree<Key, Value>::parallelDepth() && count >= AVL_PARALLEL_MIN_BATCH)
+  {
+    TaskGroup group(WorkStealingPool::shared());
+    group.spawn([&]() { l = removeSorted(lower, hlower, keys, mid, removed, depth + 1, hl); });
+    r = removeSorted(upper, hupper, keys + mid + 1, count - mid - 1, removed + mid + 1, depth + 1, hr);
+    group.wait();
+  }
+  else
+  {
+    l = removeSorted(lower, hlower, keys, mid, removed, depth + 1, hl);
+    r = removeSorted(upper, hupper, keys + mid + 1, count - mid - 1, removed + mid + 1, depth + 1, hr);
+  }
+  return join2(l, hl, r, hr, h);
+}
+
+template<class Key, class Value>
+void AVLTree<Key, Value>::nodeSwap( AVLNode<Key,Value>* n1, AVLNode<Key,Value>* n2)
+{
+    BinarySearchTree<Key, Value>::nodeSwap(n1, n2);
+    int8_t tempB = n1->getBalance();
+    n1->setBalance(n2->getBalance());
+    n2->setBalance(tempB);
+}
+
+
+/**
+* An AVL tree that keeps every inserted item, so equal keys live in separate
+* nodes. Items with equal keys iterate in the order they were inserted. All
+* rebalancing goes through the AVLTree insertFix/removeFix machinery.
+*/
+template <class Key, class Value>
+class AVLMultiTree : public AVLTree<Key, Value>
+{
+public:
+    typedef typename BinarySearchTree<Key, Value>::iterator iterator;
+
+    virtual void insert (const std::pair<const Key, Value> &new_item);
+    virtual void remove(const Key& key);
+    virtual void erase(const Key& lo, const Key& hi);
+    void erase(iterator pos);
+
+    size_t count(const Key& key) const;
+    std::pair<iterator, iterator> equal_range(const Key& key) const;
+
+    // Matching keys is ambiguous with duplicates on both sides
+    void unionWith(AVLTree<Key, Value>& other) = delete;
+    void intersect(AVLTree<Key, Value>& other) = delete;
+    void difference(AVLTree<Key, Value>& other) = delete;
+    AVLTree<Key, Value> splitOff(const Key& key) = delete;
+    void concat(AVLTree<Key, Value>& other) = delete;
+    template<class InputIt>
+    void insert_batch(InputIt first, InputIt last) = delete;
+    template<class InputIt>
+    void remove_batch(InputIt first, InputIt last) = delete;
+    void find_many(const std::vector<Key>& keys, std::vector<iterator>& out) const = delete;
+    // find resolves duplicates through lowerBound, which the cache cannot
+    void enableCache(size_t slots = 4096) = delete;
+protected:
+    virtual Node<Key, Value>* internalFind(const Key& key) const;
+    AVLNode<Key, Value>* lowerBound(const Key& key) const;
+};
+
+/*
+ * Inserts a new node even if the key is already present. Equal keys go to
+ * the right so later items come after earlier ones.
+ */
+template<class Key, class Value>
+void AVLMultiTree<Key, Value>::insert (const std::pair<const Key, Value> &new_item)
+{
+    if (this->root_ == NULL)
+    {
+      this->root_ = new AVLNode<Key, Value>(new_item.first, new_item.second, NULL); 
+      this->size_++;
+      this->filterAdd(new_item.first);
+      return;
+    }
+    AVLNode<Key, Value>* traveler = this->conversion(this->root_);
+    size_t depth = 1;
+    while (true)
+    {
+      if (new_item.first < traveler->getKey())
+      {
+        if (traveler->getLeft() == NULL)
+        {
+          this->attachLeaf(traveler, new AVLNode<Key, Value>(new_item.first, new_item.second, traveler), true, depth);
+          return;
+        }
+        traveler = traveler->getLeft();
+      }
+      else
+      {
+        if (traveler->getRight() == NULL)
+        {
+          this->attachLeaf(traveler, new AVLNode<Key, Value>(new_item.first, new_item.second, traveler), false, depth);
+          return;
+        }
+        traveler = traveler->getRight();
+      }
+      depth++;
+    }
+}
+
+/*
+ * Removes every item with the given key.
+ */
+template<class Key, class Value>
+void AVLMultiTree<Key, Value>::remove(const Key& key)
+{
+    erase(key, key);
+}
+
+/*
+ * Removes every item with lo <= key <= hi, one node at a time. Each removal
+ * is O(log n) with no search since the next node is reached by iterating.
+ */
+template<class Key, class Value>
+void AVLMultiTree<Key, Value>::erase(const Key& lo, const Key& hi)
+{
+    if (hi < lo) return;
+    AVLNode<Key, Value>* n = lowerBound(lo);
+    while (n != NULL && !(hi < n->getKey()))
+    {
+      // removeNode may move the predecessor into n's place but never the
+      // successor, so the next node is safe to take first
+      Node<Key, Value>* next = n;
+      BinarySearchTree<Key, Value>::successor(next);
+      this->removeNode(n);
+      n = this->conversion(next);
+    }
+}
+
+/*
+ * Removes the single item the iterator points at.
+ */
+template<class Key, class Value>
+void AVLMultiTree<Key, Value>::erase(iterator pos)
+{
+    Node<Key, Value>* n = BinarySearchTree<Key, Value>::nodeAt(pos);
+    if (n != NULL) this->removeNode(this->conversion(n));
+}
+
+/*
+ * Returns how many items have the given key. O(log n + count).
+ */
+template<class Key, class Value>
+size_t AVLMultiTree<Key, Value>::count(const Key& key) const
+{
+    size_t total = 0;
+    Node<Key, Value>* n = lowerBound(key);
+    while (n != NULL && n->getKey() == key)
+    {
+      total++;
+      BinarySearchTree<Key, Value>::successor(n);
+    }
+    return total;
+}
+
+/*
+ * Returns the iterators bounding the items with the given key, in
+ * insertion order.
+ */
+template<class Key, class Value>
+std::pair<typename AVLMultiTree<Key, Value>::iterator, typename AVLMultiTree<Key, Value>::iterator>
+AVLMultiTree<Key, Value>::equal_range(const Key& key) const
+{
+    Node<Key, Value>* first = lowerBound(key);
+    Node<Key, Value>* last = first;
+    while (last != NULL && last->getKey() == key)
+    {
+      BinarySearchTree<Key, Value>::successor(last);
+    }
+    return std::make_pair(this->iteratorAt(first), this->iteratorAt(last));
+}
+
+/*
+ * With duplicates, find and operator[] resolve to the earliest item.
+ */
+template<class Key, class Value>
+Node<Key, Value>* AVLMultiTree<Key, Value>::internalFind(const Key& key) const
+{
+    if (this->filterRejects(key)) return NULL;
+    AVLNode<Key, Value>* n = lowerBound(key);
+    if (n != NULL && n->getKey() == key) return n;
+    return NULL;
+}
+
+/*
+ * Returns the first node whose key is not less than key.
+ */
+template<class Key, class Value>
+AVLNode<Key, Value>* AVLMultiTree<Key, Value>::lowerBound(const Key& key) const
+{
+    AVLNode<Key, Value>* traveler = this->conversion(this->root_);
+    AVLNode<Key, Value>* best = NULL;
+    while (traveler != NULL)
+    {
+      if (traveler->getKey() < key)
+      {
+        traveler = traveler->getRight();
+      }
+      else
+      {
+        best = traveler;
+        traveler = traveler->getLeft();
+      }
+    }
+    return best;
 }
 
 
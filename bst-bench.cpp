@@ -0,0 +1,580 @@
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <cstdlib>
+#include <cmath>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include "bst.h"
+#include "avlbst.h"
+#include "rbbst.h"
+#include "wavlbst.h"
+#include "splaybst.h"
+#include "treap.h"
+#include "weightedbst.h"
+#include "radixtree.h"
+#include "shardedmap.h"
+#include "concurrentavl.h"
+#include "persistentavl.h"
+#include "skiplist.h"
+#include "flatcombining.h"
+
+using namespace std;
+
+// Milliseconds since start
+static double elapsedMs(chrono::steady_clock::time_point start)
+{
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+static void report(const char* workload, const char* tree, double ms, size_t ops)
+{
+    cout << left << setw(24) << workload << setw(16) << tree
+         << right << setw(10) << fixed << setprecision(1) << ms << " ms"
+         << setw(10) << setprecision(1) << (ops / ms / 1000.0) << " Mops/s" << endl;
+}
+
+// Runs ops random operations over keys in [0, keySpace): insertPct percent
+// inserts, removePct percent removes, and lookups for the rest.
+template<typename Tree>
+double mixedWorkload(Tree& tree, size_t ops, int keySpace, int insertPct, int removePct, unsigned seed)
+{
+    mt19937 rng(seed);
+    uniform_int_distribution<int> key(0, keySpace - 1);
+    uniform_int_distribution<int> pct(0, 99);
+    size_t found = 0;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for(size_t i = 0; i < ops; ++i) {
+        int k = key(rng);
+        int p = pct(rng);
+        if(p < insertPct) {
+            tree.insert(make_pair(k, (int)i));
+        }
+        else if(p < insertPct + removePct) {
+            tree.remove(k);
+        }
+        else if(tree.find(k) != tree.end()) {
+            ++found;
+        }
+    }
+    double ms = elapsedMs(start);
+    // keep the lookups from being optimized away
+    if(found == ops + 1) cout << "";
+    return ms;
+}
+
+template<typename Tree>
+void benchMixed(const char* name, size_t n)
+{
+    struct Mix { const char* label; int insertPct; int removePct; };
+    const Mix mixes[] = {
+        { "insert only", 100, 0 },
+        { "50/50 insert/remove", 50, 50 },
+        { "40/40/20 ins/rem/find", 40, 40 },
+        { "10/10/80 ins/rem/find", 10, 10 },
+    };
+    for(const Mix& mix : mixes) {
+        Tree tree;
+        // prefill half the key space so removes and finds have something to hit
+        mixedWorkload(tree, n / 2, (int)n, 100, 0, 1);
+        double ms = mixedWorkload(tree, n, (int)n, mix.insertPct, mix.removePct, 2);
+        report(mix.label, name, ms, n);
+    }
+}
+
+// Times an insert burst of n keys, sorted or shuffled, into an AVLTree,
+// optionally relaxed. The closing rebalance() is timed separately.
+static void benchIngest(bool sorted, bool relaxed, size_t n)
+{
+    vector<int> keys(n);
+    for(size_t i = 0; i < n; ++i) keys[i] = (int)i;
+    if(!sorted) shuffle(keys.begin(), keys.end(), mt19937(4));
+    AVLTree<int,int> tree;
+    tree.setRelaxed(relaxed);
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for(size_t i = 0; i < n; ++i) {
+        tree.insert(make_pair(keys[i], (int)i));
+    }
+    double ms = elapsedMs(start);
+    start = chrono::steady_clock::now();
+    tree.rebalance();
+    double fixMs = elapsedMs(start);
+    report(sorted ? "sorted ingest" : "shuffled ingest", relaxed ? "AVL relaxed" : "AVLTree", ms, n);
+    if(relaxed) report("  then rebalance()", "AVL relaxed", fixMs, n);
+}
+
+// n lookups of random present keys in an n-key AVLTree, one find() each
+// against a single find_many over the whole batch.
+static void benchFindMany(size_t n)
+{
+    vector<int> keys(n);
+    for(size_t i = 0; i < n; ++i) keys[i] = (int)i;
+    shuffle(keys.begin(), keys.end(), mt19937(9));
+    AVLTree<int,int> tree;
+    for(size_t i = 0; i < n; ++i) {
+        tree.insert(make_pair(keys[i], (int)i));
+    }
+    mt19937 rng(10);
+    uniform_int_distribution<int> key(0, (int)n - 1);
+    vector<int> lookups(n);
+    for(size_t i = 0; i < n; ++i) lookups[i] = key(rng);
+
+    size_t found = 0;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for(size_t i = 0; i < n; ++i) {
+        if(tree.find(lookups[i]) != tree.end()) ++found;
+    }
+    report("random find", "find", elapsedMs(start), n);
+    vector<AVLTree<int,int>::iterator> out;
+    start = chrono::steady_clock::now();
+    tree.find_many(lookups, out);
+    report("random find", "find_many", elapsedMs(start), n);
+    for(size_t i = 0; i < n; ++i) {
+        if(out[i] != tree.end()) --found;
+    }
+    if(found != 0) cout << "  find_many disagrees with find!" << endl;
+}
+
+// Times n lookups of keys that are all absent from an n-key AVLTree,
+// with and without the membership filter.
+static void benchMisses(bool filtered, size_t n)
+{
+    AVLTree<int,int> tree;
+    if(filtered) tree.enableFilter(n);
+    for(size_t i = 0; i < n; ++i) {
+        tree.insert(make_pair((int)(2 * i), (int)i));
+    }
+    mt19937 rng(5);
+    uniform_int_distribution<int> key(0, (int)n - 1);
+    size_t found = 0;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for(size_t i = 0; i < n; ++i) {
+        if(tree.find(2 * key(rng) + 1) != tree.end()) ++found;
+    }
+    double ms = elapsedMs(start);
+    if(found == n + 1) cout << "";
+    report("absent-key find", filtered ? "AVL + filter" : "AVLTree", ms, n);
+}
+
+// The usual way to share a tree between threads: one mutex around every call
+class LockedAVLMap
+{
+public:
+    void insert(const pair<const int, int>& item)
+    {
+        lock_guard<mutex> guard(lock_);
+        tree_.insert(item);
+    }
+    void remove(int key)
+    {
+        lock_guard<mutex> guard(lock_);
+        tree_.remove(key);
+    }
+    bool find(int key, int& value)
+    {
+        lock_guard<mutex> guard(lock_);
+        AVLTree<int,int>::iterator it = tree_.find(key);
+        if(it == tree_.end()) return false;
+        value = it->second;
+        return true;
+    }
+private:
+    mutex lock_;
+    AVLTree<int,int> tree_;
+};
+
+// Splits n operations over n keys between threads sharing one map:
+// updatePct percent updates, half inserts and half removes, and lookups for
+// the rest. Every value stored equals its key, so a lookup that sees any
+// other value means the map broke under concurrency; those are counted in
+// wrong.
+template<typename Map>
+double threadedWorkload(Map& map, size_t n, unsigned threads, int updatePct, atomic<size_t>& wrong)
+{
+    vector<thread> workers;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for(unsigned t = 0; t < threads; ++t) {
+        workers.push_back(thread([&map, &wrong, n, threads, t, updatePct]() {
+            mt19937 rng(10 + t);
+            uniform_int_distribution<int> key(0, (int)n - 1);
+            uniform_int_distribution<int> pct(0, 99);
+            size_t found = 0;
+            int value;
+            for(size_t i = t; i < n; i += threads) {
+                int k = key(rng);
+                int p = pct(rng);
+                if(p < updatePct / 2) map.insert(make_pair(k, k));
+                else if(p < updatePct) map.remove(k);
+                else if(map.find(k, value)) {
+                    ++found;
+                    if(value != k) ++wrong;
+                }
+            }
+            if(found == n + 1) cout << "";
+        }));
+    }
+    for(thread& worker : workers) worker.join();
+    return elapsedMs(start);
+}
+
+template<typename Map>
+void benchThreaded(const char* label, const char* name, Map& map, size_t n, unsigned threads, int updatePct)
+{
+    for(size_t i = 0; i < n; i += 2) {
+        map.insert(make_pair((int)i, (int)i));
+    }
+    atomic<size_t> wrong(0);
+    report(label, name, threadedWorkload(map, n, threads, updatePct, wrong), n);
+    if(wrong != 0) cout << "  " << name << " returned " << wrong << " wrong values!" << endl;
+}
+
+// Compares the shared maps from one thread up to at least four, doubling
+// each step.
+static void benchThreads(size_t n, int updatePct)
+{
+    unsigned maxThreads = max(4u, thread::hardware_concurrency());
+    vector<int> splits;
+    for(int i = 1; i < 64; ++i) splits.push_back((int)(n * i / 64));
+    for(unsigned threads = 1; threads <= maxThreads; threads *= 2) {
+        ostringstream label;
+        label << threads << (threads == 1 ? " thread" : " threads");
+        LockedAVLMap locked;
+        ShardedAVLMap<int,int> sharded(splits);
+        ConcurrentAVLTree<int,int> concurrent;
+        CombiningAVLTree<int,int> combining;
+        benchThreaded(label.str().c_str(), "AVL + mutex", locked, n, threads, updatePct);
+        benchThreaded(label.str().c_str(), "CombiningAVL", combining, n, threads, updatePct);
+        benchThreaded(label.str().c_str(), "ShardedAVLMap", sharded, n, threads, updatePct);
+        benchThreaded(label.str().c_str(), "ConcurrentAVL", concurrent, n, threads, updatePct);
+    }
+}
+
+// Has threads insert n shuffled keys, each its own share, into one map.
+template<typename Map>
+double threadedIngest(Map& map, const vector<int>& keys, unsigned threads)
+{
+    vector<thread> workers;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for(unsigned t = 0; t < threads; ++t) {
+        workers.push_back(thread([&map, &keys, threads, t]() {
+            for(size_t i = t; i < keys.size(); i += threads) {
+                map.insert(make_pair(keys[i], keys[i]));
+            }
+        }));
+    }
+    for(thread& worker : workers) worker.join();
+    return elapsedMs(start);
+}
+
+// Write-heavy ingest from 1 to 64 threads: the lock-free skip list and the
+// flat-combining tree against a mutex-wrapped AVLTree.
+static void benchIngestThreads(size_t n)
+{
+    vector<int> keys(n);
+    for(size_t i = 0; i < n; ++i) keys[i] = (int)i;
+    shuffle(keys.begin(), keys.end(), mt19937(7));
+    for(unsigned threads = 1; threads <= 64; threads *= 2) {
+        ostringstream label;
+        label << threads << (threads == 1 ? " thread" : " threads");
+        LockedAVLMap locked;
+        ConcurrentSkipList<int,int> skipList;
+        CombiningAVLTree<int,int> combining;
+        report(label.str().c_str(), "AVL + mutex", threadedIngest(locked, keys, threads), n);
+        report(label.str().c_str(), "CombiningAVL", threadedIngest(combining, keys, threads), n);
+        report(label.str().c_str(), "SkipList", threadedIngest(skipList, keys, threads), n);
+        if(skipList.size() != n) cout << "  SkipList holds " << skipList.size() << " keys!" << endl;
+    }
+}
+
+// Applies a batch of shuffled updates to an AVLTree holding the even keys
+// below 2n, half of them new odd keys, one call per key against one batch
+// call, then removes the same keys again both ways.
+static void benchBatches(size_t n, size_t batch)
+{
+    vector<pair<int,int> > updates(batch);
+    vector<int> keys(batch);
+    mt19937 rng(8);
+    uniform_int_distribution<int> key(0, 2 * (int)n - 1);
+    for(size_t i = 0; i < batch; ++i) {
+        updates[i] = make_pair(key(rng), (int)i);
+        keys[i] = updates[i].first;
+    }
+    AVLTree<int,int> one, batched;
+    for(size_t i = 0; i < n; ++i) {
+        one.insert(make_pair((int)(2 * i), (int)i));
+        batched.insert(make_pair((int)(2 * i), (int)i));
+    }
+
+    ostringstream label;
+    label << "insert " << batch;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for(size_t i = 0; i < batch; ++i) {
+        one.insert(updates[i]);
+    }
+    report(label.str().c_str(), "insert", elapsedMs(start), batch);
+    start = chrono::steady_clock::now();
+    batched.insert_batch(updates.begin(), updates.end());
+    report(label.str().c_str(), "insert_batch", elapsedMs(start), batch);
+
+    label.str("");
+    label << "remove " << batch;
+    start = chrono::steady_clock::now();
+    for(size_t i = 0; i < batch; ++i) {
+        one.remove(keys[i]);
+    }
+    report(label.str().c_str(), "remove", elapsedMs(start), batch);
+    start = chrono::steady_clock::now();
+    batched.remove_batch(keys.begin(), keys.end());
+    report(label.str().c_str(), "remove_batch", elapsedMs(start), batch);
+    if(one.size() != batched.size()) cout << "  batched tree disagrees with the sequential one!" << endl;
+}
+
+// Time the dropping thread spends tearing down an n-key AVLTree: freeing
+// it in place, handing it to the background reclaimer, and the longest
+// pause while freeing it in slices of 4096 nodes.
+static void benchTeardown(size_t n)
+{
+    AVLTree<int,int>* trees[3];
+    for(int t = 0; t < 3; ++t) {
+        trees[t] = new AVLTree<int,int>();
+        for(size_t i = 0; i < n; ++i) {
+            trees[t]->insert(make_pair((int)i, (int)i));
+        }
+    }
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    delete trees[0];
+    report("drop tree", "destructor", elapsedMs(start), n);
+
+    trees[1]->setBackgroundClear(true);
+    start = chrono::steady_clock::now();
+    delete trees[1];
+    report("drop tree", "background", elapsedMs(start), n);
+    start = chrono::steady_clock::now();
+    BackgroundReclaimer::drain();
+    report("  reclaimer finishes", "background", elapsedMs(start), n);
+
+    double longest = 0;
+    start = chrono::steady_clock::now();
+    ReleasedNodes<int,int> released = trees[2]->release();
+    delete trees[2];
+    longest = elapsedMs(start);
+    while(!released.done()) {
+        start = chrono::steady_clock::now();
+        released.reclaim(BackgroundReclaimer::sliceNodes);
+        longest = max(longest, elapsedMs(start));
+    }
+    report("longest pause", "reclaim slices", longest, BackgroundReclaimer::sliceNodes);
+}
+
+// Whole-tree passes over an n-key AVLTree: summing the values and
+// rewriting every value, through the iterator and through the pool.
+static void benchPasses(size_t n)
+{
+    AVLTree<int,long> tree;
+    for(size_t i = 0; i < n; ++i) {
+        tree.insert(make_pair((int)i, (long)i));
+    }
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    long sum = 0;
+    for(AVLTree<int,long>::iterator it = tree.begin(); it != tree.end(); ++it) {
+        sum += it->second;
+    }
+    report("sum values", "iterator", elapsedMs(start), n);
+    start = chrono::steady_clock::now();
+    sum -= tree.parallel_reduce(0L, [](const pair<const int,long>& item) { return item.second; },
+                                [](long a, long b) { return a + b; });
+    report("sum values", "parallel_reduce", elapsedMs(start), n);
+
+    start = chrono::steady_clock::now();
+    for(AVLTree<int,long>::iterator it = tree.begin(); it != tree.end(); ++it) {
+        it->second = it->second * 3 + 1;
+    }
+    report("revalue", "iterator", elapsedMs(start), n);
+    start = chrono::steady_clock::now();
+    tree.parallel_transform_values([](const pair<const int,long>& item) { return item.second * 3 + 1; });
+    report("revalue", "parallel_transf", elapsedMs(start), n);
+    if(sum != 0) cout << "  parallel_reduce disagrees with the iterator!" << endl;
+}
+
+// Times n shuffled inserts into an AVLTree and a PersistentAVLTree, then
+// the cost of a consistent view of each: a deep copy against a snapshot.
+static void benchSnapshots(size_t n)
+{
+    vector<int> keys(n);
+    for(size_t i = 0; i < n; ++i) keys[i] = (int)i;
+    shuffle(keys.begin(), keys.end(), mt19937(6));
+    const size_t views = 10;
+
+    AVLTree<int,int> tree;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for(size_t i = 0; i < n; ++i) {
+        tree.insert(make_pair(keys[i], (int)i));
+    }
+    report("shuffled insert", "AVLTree", elapsedMs(start), n);
+    start = chrono::steady_clock::now();
+    size_t total = 0;
+    for(size_t i = 0; i < views; ++i) {
+        AVLTree<int,int> copy(tree);
+        total += copy.size();
+    }
+    report("view (deep copy)", "AVLTree", elapsedMs(start), views);
+
+    PersistentAVLTree<int,int> persistent;
+    start = chrono::steady_clock::now();
+    for(size_t i = 0; i < n; ++i) {
+        persistent.insert(make_pair(keys[i], (int)i));
+    }
+    report("shuffled insert", "PersistentAVL", elapsedMs(start), n);
+    start = chrono::steady_clock::now();
+    for(size_t i = 0; i < views; ++i) {
+        AVLSnapshot<int,int> view = persistent.snapshot();
+        total += view.size();
+    }
+    report("view (snapshot)", "PersistentAVL", elapsedMs(start), views);
+    if(total == 1) cout << "";
+}
+
+// Draws ranks in [0, n) with probability proportional to 1 / (rank + 1)^s
+class Zipf
+{
+public:
+    Zipf(size_t n, double s) : cdf_(n)
+    {
+        double total = 0;
+        for(size_t i = 0; i < n; ++i) {
+            total += 1.0 / pow((double)(i + 1), s);
+            cdf_[i] = total;
+        }
+        for(size_t i = 0; i < n; ++i) {
+            cdf_[i] /= total;
+        }
+    }
+    template<typename Rng>
+    size_t operator()(Rng& rng) const
+    {
+        double u = uniform_real_distribution<double>(0.0, 1.0)(rng);
+        return min(cdf_.size() - 1, (size_t)(lower_bound(cdf_.begin(), cdf_.end(), u) - cdf_.begin()));
+    }
+private:
+    vector<double> cdf_;
+};
+
+// Builds a trace of n lookups whose popularity follows Zipf(s) over n keys.
+// Ranks are scattered over the key space so hot keys are not neighbours.
+static vector<int> zipfTrace(size_t n, double s)
+{
+    mt19937 rng(3);
+    vector<int> keyOfRank(n);
+    for(size_t i = 0; i < n; ++i) keyOfRank[i] = (int)i;
+    shuffle(keyOfRank.begin(), keyOfRank.end(), rng);
+    Zipf zipf(n, s);
+    vector<int> trace(n);
+    for(size_t i = 0; i < n; ++i) trace[i] = keyOfRank[zipf(rng)];
+    return trace;
+}
+
+// An AVLTree with its hot-key cache on, for the skewed lookups
+struct CachedAVLTree : public AVLTree<int,int>
+{
+    CachedAVLTree() { enableCache(4096); }
+};
+
+// Lets adaptive trees act on what the warm-up pass showed them
+template<typename Tree>
+void settle(Tree&)
+{
+}
+
+template<typename Key, typename Value>
+void settle(WeightedTree<Key, Value>& tree)
+{
+    tree.rebuildByWeight();
+}
+
+template<typename Tree>
+void benchZipf(const char* name, size_t n, double s, const vector<int>& trace)
+{
+    Tree tree;
+    mixedWorkload(tree, n, (int)n, 100, 0, 1);
+    size_t found = 0;
+    // one untimed pass so adaptive trees have seen the distribution
+    for(size_t i = 0; i < trace.size(); ++i) {
+        if(tree.find(trace[i]) != tree.end()) ++found;
+    }
+    settle(tree);
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for(size_t i = 0; i < trace.size(); ++i) {
+        if(tree.find(trace[i]) != tree.end()) ++found;
+    }
+    double ms = elapsedMs(start);
+    if(found == 2 * trace.size() + 1) cout << "";
+    ostringstream label;
+    label << "zipf s=" << s << " find";
+    report(label.str().c_str(), name, ms, trace.size());
+}
+
+int main(int argc, char *argv[])
+{
+    size_t n = 200000;
+    if(argc > 1) n = strtoul(argv[1], NULL, 10);
+
+    cout << "Mixed workloads, " << n << " operations each" << endl;
+    benchMixed<AVLTree<int,int> >("AVLTree", n);
+    benchMixed<RedBlackTree<int,int> >("RedBlackTree", n);
+    benchMixed<WAVLTree<int,int> >("WAVLTree", n);
+    benchMixed<Treap<int,int> >("Treap", n);
+    benchMixed<AdaptiveRadixTree<int,int> >("AdaptiveRadix", n);
+
+    cout << "\nInsert bursts, " << n << " keys" << endl;
+    for(int sorted = 1; sorted >= 0; --sorted) {
+        benchIngest(sorted, false, n);
+        benchIngest(sorted, true, n);
+    }
+
+    cout << "\nBatched lookups, " << n << " finds over " << n << " keys" << endl;
+    benchFindMany(n);
+
+    cout << "\nNegative lookups, " << n << " misses over " << n << " keys" << endl;
+    benchMisses(false, n);
+    benchMisses(true, n);
+
+    cout << "\nSkewed lookups, " << n << " finds over " << n << " keys" << endl;
+    const double skews[] = { 0.8, 0.99, 1.2 };
+    for(double s : skews) {
+        vector<int> trace = zipfTrace(n, s);
+        benchZipf<AVLTree<int,int> >("AVLTree", n, s, trace);
+        benchZipf<CachedAVLTree>("AVL + cache", n, s, trace);
+        benchZipf<SplayTree<int,int> >("SplayTree", n, s, trace);
+        benchZipf<WeightedTree<int,int> >("WeightedTree", n, s, trace);
+    }
+
+    cout << "\nBatched updates to " << n << " keys" << endl;
+    benchBatches(n, n / 100);
+    benchBatches(n, n);
+
+    cout << "\nTearing down " << n << " keys" << endl;
+    benchTeardown(n);
+
+    cout << "\nWhole-tree passes over " << n << " keys, pool of "
+         << WorkStealingPool::shared().workers() << " workers plus the caller" << endl;
+    benchPasses(n);
+
+    cout << "\nConsistent views of " << n << " keys" << endl;
+    benchSnapshots(n);
+
+    cout << "\nThreads sharing one map, " << n << " 10/10/80 ins/rem/find operations" << endl;
+    benchThreads(n, 20);
+    cout << "\nThreads sharing one map, " << n << " 1/1/98 ins/rem/find operations" << endl;
+    benchThreads(n, 2);
+
+    cout << "\nThreads ingesting " << n << " shuffled keys into one map" << endl;
+    benchIngestThreads(n);
+
+    return 0;
+}
@@ -1,10 +1,33 @@
 #include <iostream>
 #include <map>
+#include <thread>
+#include <vector>
 #include "bst.h"
 #include "avlbst.h"
+#include "rbbst.h"
+#include "wavlbst.h"
+#include "splaybst.h"
+#include "treap.h"
+#include "scapegoatbst.h"
+#include "weightedbst.h"
+#include "radixtree.h"
+#include "staticmap.h"
+#include "shardedmap.h"
+#include "concurrentavl.h"
+#include "persistentavl.h"
+#include "skiplist.h"
+#include "flatcombining.h"
 
 using namespace std;
 
+// A lookup table built entirely at compile time
+constexpr StaticMap<int, const char*, 4> statusText = {{
+    {200, "OK"}, {301, "Moved"}, {404, "Not Found"}, {500, "Server Error"}
+}};
+static_assert(statusText.sorted(), "statusText must be sorted by key");
+static_assert(statusText.find(404) != statusText.end(), "404 is in the table");
+static_assert(statusText.find(403) == statusText.end(), "403 is not in the table");
+
 
 int main(int argc, char *argv[])
 {
@@ -43,6 +66,304 @@ int main(int argc, char *argv[])
     }
     cout << "Erasing b" << endl;
     at.remove('b');
+    cout << "Size after erasing: " << at.size() << endl;
+
+    // Range erase
+    for(char c = 'b'; c <= 'f'; ++c) {
+        at.insert(std::make_pair(c, c - 'a' + 1));
+    }
+    cout << "\nErasing b through d" << endl;
+    at.erase('b', 'd');
+    for(AVLTree<char,int>::iterator it = at.begin(); it != at.end(); ++it) {
+        cout << it->first << " " << it->second << endl;
+    }
+
+    // Copying
+    AVLTree<char,int> copy(at);
+    copy.remove('e');
+    cout << "\nCopy has " << copy.size() << " items, original has " << at.size() << endl;
+
+    // Set operations
+    AVLTree<char,int> other;
+    other.insert(std::make_pair('a', 10));
+    other.insert(std::make_pair('c', 30));
+    cout << "\nUnion with a and c" << endl;
+    at.unionWith(other);
+    for(AVLTree<char,int>::iterator it = at.begin(); it != at.end(); ++it) {
+        cout << it->first << " " << it->second << endl;
+    }
+
+    // Relaxed balance mode
+    AVLTree<int,int> burst;
+    burst.setRelaxed(true);
+    for(int i = 1; i <= 100; ++i) {
+        burst.insert(std::make_pair(i, i));
+    }
+    burst.rebalance();
+    cout << "\nRelaxed AVLTree after a sorted burst and rebalance(), balanced: "
+         << burst.isBalanced() << endl;
+
+    // Membership filter
+    AVLTree<int,int> filtered;
+    filtered.enableFilter();
+    for(int i = 0; i < 10; ++i) {
+        filtered.insert(std::make_pair(i * 2, i));
+    }
+    filtered.remove(4);
+    cout << "\nFiltered AVLTree finds 6: " << (filtered.find(6) != filtered.end())
+         << ", finds 4: " << (filtered.find(4) != filtered.end())
+         << ", finds 7: " << (filtered.find(7) != filtered.end()) << endl;
+
+    // Hot-key cache
+    AVLTree<int,int> cached;
+    cached.enableCache(64);
+    for(int i = 0; i < 10; ++i) {
+        cached.insert(std::make_pair(i, i * i));
+    }
+    int hot = cached[7] + cached[7];
+    cached.remove(7);
+    cout << "\nCached AVLTree reads 7 twice for " << hot
+         << ", then after remove finds 7: " << (cached.find(7) != cached.end()) << endl;
+
+    // Batch updates
+    AVLTree<int,int> batched;
+    std::vector<std::pair<int,int> > updates;
+    for(int i = 100; i >= 1; --i) {
+        updates.push_back(std::make_pair(i, i));
+    }
+    batched.insert_batch(updates.begin(), updates.end());
+    std::vector<int> evens;
+    for(int i = 2; i <= 100; i += 2) {
+        evens.push_back(i);
+    }
+    batched.remove_batch(evens.begin(), evens.end());
+    cout << "\nAVLTree after insert_batch of 1..100 and remove_batch of the evens: "
+         << batched.size() << " items, balanced: " << batched.isBalanced() << endl;
+
+    // Batched lookups
+    std::vector<int> wanted;
+    wanted.push_back(3);
+    wanted.push_back(4);
+    wanted.push_back(99);
+    std::vector<AVLTree<int,int>::iterator> hits;
+    batched.find_many(wanted, hits);
+    cout << "\nfind_many of 3, 4, 99 finds:";
+    for(size_t i = 0; i < hits.size(); ++i) {
+        cout << " " << (hits[i] != batched.end());
+    }
+    cout << endl;
+
+    // Deferred teardown
+    ReleasedNodes<int,int> released = batched.release();
+    size_t slices = 0;
+    while(!released.done()) {
+        released.reclaim(16);
+        slices++;
+    }
+    cout << "\nReleased AVLTree is empty: " << batched.empty()
+         << ", its nodes freed in " << slices << " slices" << endl;
+    burst.setBackgroundClear(true);
+    burst.clear();
+    BackgroundReclaimer::drain();
+
+    // Multimap mode
+    AVLMultiTree<int,char> mt;
+    mt.insert(std::make_pair(5,'x'));
+    mt.insert(std::make_pair(3,'y'));
+    mt.insert(std::make_pair(5,'z'));
+    cout << "\nAVLMultiTree has " << mt.count(5) << " items with key 5:" << endl;
+    std::pair<AVLMultiTree<int,char>::iterator, AVLMultiTree<int,char>::iterator> range = mt.equal_range(5);
+    for(AVLMultiTree<int,char>::iterator it = range.first; it != range.second; ++it) {
+        cout << it->first << " " << it->second << endl;
+    }
+    mt.erase(range.first);
+    cout << "After erasing the first, " << mt.count(5) << " left" << endl;
+
+    // Red Black Tree tests
+    RedBlackTree<int,int> rt;
+    for(int i = 1; i <= 5; ++i) {
+        rt.insert(std::make_pair(i, i * i));
+    }
+    rt.remove(3);
+    cout << "\nRedBlackTree contents:" << endl;
+    for(RedBlackTree<int,int>::iterator it = rt.begin(); it != rt.end(); ++it) {
+        cout << it->first << " " << it->second << endl;
+    }
+
+    // WAVL Tree tests
+    WAVLTree<int,int> wt;
+    for(int i = 1; i <= 5; ++i) {
+        wt.insert(std::make_pair(i, -i));
+    }
+    wt.remove(1);
+    wt.remove(2);
+    cout << "\nWAVLTree contents:" << endl;
+    for(WAVLTree<int,int>::iterator it = wt.begin(); it != wt.end(); ++it) {
+        cout << it->first << " " << it->second << endl;
+    }
+
+    // Splay Tree tests
+    SplayTree<int,int> st;
+    for(int i = 1; i <= 5; ++i) {
+        st.insert(std::make_pair(i, i));
+    }
+    st[2] = 20;
+    cout << "\nSplayTree after accessing 2:" << endl;
+    for(SplayTree<int,int>::iterator it = st.begin(); it != st.end(); ++it) {
+        cout << it->first << " " << it->second << endl;
+    }
+
+    // Treap tests
+    Treap<int,int> tr;
+    for(int i = 1; i <= 8; ++i) {
+        tr.insert(std::make_pair(i, i * 10));
+    }
+    Treap<int,int> middle = tr.extract(3, 5);
+    cout << "\nTreap extracted " << middle.size() << " items, " << tr.size() << " left" << endl;
+    Treap<int,int> tail = tr.extract(6, 8);
+    tr.concat(tail);
+    for(Treap<int,int>::iterator it = tr.begin(); it != tr.end(); ++it) {
+        cout << it->first << " " << it->second << endl;
+    }
+
+    // Scapegoat Tree tests
+    ScapegoatTree<int,int> sg;
+    for(int i = 1; i <= 1000; ++i) {
+        sg.insert(std::make_pair(i, i));
+    }
+    sg.erase(1, 900);
+    cout << "\nScapegoatTree after sorted inserts and a range erase, "
+         << sg.size() << " items, balanced: " << sg.isBalanced() << endl;
+
+    // Weighted Tree tests
+    WeightedTree<int,int> wgt(0, 1);
+    for(int i = 1; i <= 7; ++i) {
+        wgt.insert(std::make_pair(i, i));
+    }
+    for(int i = 0; i < 10; ++i) {
+        wgt.find(6);
+    }
+    wgt.rebuildByWeight();
+    cout << "\nWeightedTree after favouring 6:" << endl;
+    wgt.print();
+
+    // Adaptive Radix Tree tests
+    AdaptiveRadixTree<string,int> art;
+    art.insert(std::make_pair(string("romane"), 1));
+    art.insert(std::make_pair(string("romanus"), 2));
+    art.insert(std::make_pair(string("rom"), 3));
+    art.insert(std::make_pair(string("rubens"), 4));
+    art.remove("romanus");
+    cout << "\nAdaptiveRadixTree in order:" << endl;
+    for(AdaptiveRadixTree<string,int>::iterator it = art.begin(); it != art.end(); ++it) {
+        cout << it->first << " " << it->second << endl;
+    }
+
+    // Static Map tests
+    cout << "\nStaticMap lookup of 404: " << statusText[404] << endl;
+    for(StaticMap<int, const char*, 4>::iterator it = statusText.begin(); it != statusText.end(); ++it) {
+        cout << it->first << " " << it->second << endl;
+    }
+
+    // Sharded Map tests
+    std::vector<int> splits;
+    splits.push_back(4);
+    ShardedAVLMap<int,int> sm(splits);
+    for(int i = 1; i <= 8; ++i) {
+        sm.insert(std::make_pair(i, i * i));
+    }
+    sm.splitShard(6);
+    cout << "\nShardedAVLMap with " << sm.shardCount() << " shards, holding "
+         << sm.shardSize(0) << ", " << sm.shardSize(1) << " and " << sm.shardSize(2) << " items" << endl;
+    sm.mergeShards(0);
+    sm.forEach(3, 6, [](int key, int value) { cout << key << " " << value << endl; });
+
+    // Concurrent AVL Tree tests
+    ConcurrentAVLTree<int,int> cat;
+    std::thread writer([&cat]() {
+        for(int i = 1; i <= 1000; ++i) {
+            cat.insert(std::make_pair(i, i));
+        }
+        for(int i = 1; i <= 1000; i += 2) {
+            cat.remove(i);
+        }
+    });
+    // lookups run alongside the writer without locking
+    for(int i = 1; i <= 1000; ++i) {
+        cat.contains(i);
+    }
+    writer.join();
+    int value = 0;
+    cout << "\nConcurrentAVLTree holds " << cat.size() << " items, 500 maps to "
+         << (cat.find(500, value) ? value : -1) << ", 501 found: " << cat.contains(501) << endl;
+
+    // Persistent AVL Tree tests
+    PersistentAVLTree<int,int> pat;
+    for(int i = 1; i <= 5; ++i) {
+        pat.insert(std::make_pair(i, i * 10));
+    }
+    AVLSnapshot<int,int> before = pat.snapshot();
+    pat.remove(3);
+    pat.insert(std::make_pair(6, 60));
+    cout << "\nPersistentAVLTree snapshot taken before the updates:" << endl;
+    for(AVLSnapshot<int,int>::iterator it = before.begin(); it != before.end(); ++it) {
+        cout << it->first << " " << it->second << endl;
+    }
+    cout << "and the tree now holds " << pat.size() << " items" << endl;
+
+    // Concurrent Skip List tests
+    ConcurrentSkipList<int,int> csl;
+    std::thread producer([&csl]() {
+        for(int i = 2; i <= 10; i += 2) {
+            csl.insert(std::make_pair(i, i));
+        }
+    });
+    for(int i = 1; i <= 9; i += 2) {
+        csl.insert(std::make_pair(i, i));
+    }
+    producer.join();
+    csl.remove(5);
+    cout << "\nConcurrentSkipList from 4:" << endl;
+    for(ConcurrentSkipList<int,int>::iterator it = csl.lower_bound(4); it != csl.end(); ++it) {
+        cout << it->first << " " << it->second << endl;
+    }
+    // more open iterators than the reclaimer has reader slots
+    std::vector<ConcurrentSkipList<int,int>::iterator> held;
+    for(int i = 0; i < 100; ++i) {
+        held.push_back(csl.begin());
+    }
+    csl.insert(std::make_pair(11, 11));
+    csl.remove(1);
+    cout << "Holding " << held.size() << " iterators, the list finds 11: " << (csl.find(11) != csl.end())
+         << ", and the first held iterator still reads " << held[0]->first << endl;
+    held.clear();
+
+    // Flat Combining tests
+    CombiningAVLTree<int,int> fc;
+    std::vector<std::thread> posters;
+    for(int t = 0; t < 4; ++t) {
+        posters.push_back(std::thread([&fc, t]() {
+            for(int i = 0; i < 100; ++i) {
+                fc.insert(std::make_pair(t * 100 + i, i));
+            }
+        }));
+    }
+    for(size_t t = 0; t < posters.size(); ++t) {
+        posters[t].join();
+    }
+    fc.remove(250);
+    cout << "\nCombiningAVLTree holds " << fc.size() << " items, 250 found: "
+         << fc.find(250, value) << ", 399 maps to " << (fc.find(399, value) ? value : -1) << endl;
+
+    // Parallel pass tests
+    AVLTree<int,int> par;
+    for(int i = 1; i <= 10; ++i) {
+        par.insert(std::make_pair(i, i));
+    }
+    par.parallel_transform_values([](const std::pair<const int,int>& item) { return item.second * item.second; });
+    int squares = par.parallel_reduce(0, [](const std::pair<const int,int>& item) { return item.second; },
+                                      [](int a, int b) { return a + b; });
+    cout << "\nSum of squares 1..10 by parallel_reduce: " << squares << endl;
 
     return 0;
 }
@@ -5,6 +5,10 @@
 #include <exception>
 #include <cstdlib>
 #include <utility>
+#include <thread>
+#include <memory>
+#include "threadpool.h"
+#include "reclaimer.h"
 
 /**
  * A templated class for a Node in a search tree.
@@ -186,6 +190,123 @@ void Node<Key, Value>::setValue(const Value& value)
   ---------------------------------------
 */
 
+template <typename Key, typename Value>
+class BinarySearchTree;
+
+/**
+* The nodes of a tree detached by release(). They are freed a slice at a
+* time by reclaim(), by the background reclaimer once handed to it, or
+* else all at once when this goes out of scope.
+*/
+template <typename Key, typename Value>
+class ReleasedNodes
+{
+public:
+    ReleasedNodes(ReleasedNodes<Key, Value>&& other);
+    ~ReleasedNodes();
+
+    size_t reclaim(size_t budget);
+    void reclaimInBackground();
+    bool done() const;
+
+    static void* freeSlice(void* cursor, size_t budget);
+
+protected:
+    friend class BinarySearchTree<Key, Value>;
+    explicit ReleasedNodes(Node<Key, Value>* root);
+    static Node<Key, Value>* freeNodes(Node<Key, Value>* cursor, size_t budget, size_t& freed);
+
+    ReleasedNodes(const ReleasedNodes<Key, Value>&);
+    ReleasedNodes<Key, Value>& operator=(const ReleasedNodes<Key, Value>&);
+
+    // where the walk freeing the nodes has got to, NULL once all are gone
+    Node<Key, Value>* cursor_;
+};
+
+template<typename Key, typename Value>
+ReleasedNodes<Key, Value>::ReleasedNodes(Node<Key, Value>* root) : cursor_(root)
+{
+}
+
+template<typename Key, typename Value>
+ReleasedNodes<Key, Value>::ReleasedNodes(ReleasedNodes<Key, Value>&& other) : cursor_(other.cursor_)
+{
+    other.cursor_ = NULL;
+}
+
+template<typename Key, typename Value>
+ReleasedNodes<Key, Value>::~ReleasedNodes()
+{
+    size_t freed = 0;
+    freeNodes(cursor_, (size_t)-1, freed);
+}
+
+/*
+* Frees at most budget nodes and returns how many it freed.
+*/
+template<typename Key, typename Value>
+size_t ReleasedNodes<Key, Value>::reclaim(size_t budget)
+{
+    size_t freed = 0;
+    cursor_ = freeNodes(cursor_, budget, freed);
+    return freed;
+}
+
+/*
+* Hands whatever is left to the background reclaimer. O(1).
+*/
+template<typename Key, typename Value>
+void ReleasedNodes<Key, Value>::reclaimInBackground()
+{
+    BackgroundReclaimer::submit(cursor_, &ReleasedNodes<Key, Value>::freeSlice);
+    cursor_ = NULL;
+}
+
+template<typename Key, typename Value>
+bool ReleasedNodes<Key, Value>::done() const
+{
+    return cursor_ == NULL;
+}
+
+/*
+* The background reclaimer's view of freeNodes.
+*/
+template<typename Key, typename Value>
+void* ReleasedNodes<Key, Value>::freeSlice(void* cursor, size_t budget)
+{
+    size_t freed = 0;
+    return freeNodes(static_cast<Node<Key, Value>*>(cursor), budget, freed);
+}
+
+/*
+* Continues a post-order walk at cursor over a detached tree, freeing up to
+* budget nodes, and returns the node to resume at, NULL when none are left.
+* Freed nodes are unlinked from their parents, so the parent pointers alone
+* carry the walk from one slice to the next, and no stack is needed.
+*/
+template<typename Key, typename Value>
+Node<Key, Value>* ReleasedNodes<Key, Value>::freeNodes(Node<Key, Value>* cursor, size_t budget, size_t& freed)
+{
+    while (cursor != NULL && freed < budget)
+    {
+      if (cursor->getLeft() != NULL) cursor = cursor->getLeft();
+      else if (cursor->getRight() != NULL) cursor = cursor->getRight();
+      else
+      {
+        Node<Key, Value>* parent = cursor->getParent();
+        if (parent != NULL)
+        {
+          if (parent->getLeft() == cursor) parent->setLeft(NULL);
+          else parent->setRight(NULL);
+        }
+        delete cursor;
+        freed++;
+        cursor = parent;
+      }
+    }
+    return cursor;
+}
+
 /**
 * A templated unbalanced binary search tree.
 */
@@ -194,13 +315,40 @@ class BinarySearchTree
 {
 public:
     BinarySearchTree(); //TODO
+    BinarySearchTree(const BinarySearchTree<Key, Value>& other);
+    BinarySearchTree(BinarySearchTree<Key, Value>&& other);
     virtual ~BinarySearchTree(); //TODO
+    BinarySearchTree<Key, Value>& operator=(const BinarySearchTree<Key, Value>& other);
+    BinarySearchTree<Key, Value>& operator=(BinarySearchTree<Key, Value>&& other);
     virtual void insert(const std::pair<const Key, Value>& keyValuePair); //TODO
     virtual void remove(const Key& key); //TODO
-    void clear(); //TODO
+    virtual void erase(const Key& lo, const Key& hi);
+    virtual void clear(); //TODO
     bool isBalanced() const; //TODO
     void print() const;
     bool empty() const;
+    size_t size() const;
+
+    // Whole-tree passes, split by subtree over the shared WorkStealingPool.
+    // The function is called from several threads at once. parallel_reduce
+    // combines in key order, so combine need only be associative.
+    template<typename F>
+    void parallel_for_each(F f);
+    template<typename F>
+    void parallel_transform_values(F f);
+    template<typename T, typename Map, typename Combine>
+    T parallel_reduce(T init, Map map, Combine combine) const;
+
+    // Deferred teardown. release() detaches every node in O(1) and returns
+    // them to be freed in bounded slices; clear_async() hands them to the
+    // BackgroundReclaimer thread instead. With setBackgroundClear(true),
+    // clear(), assignment and the destructor do the same, so dropping a big
+    // tree never stalls the calling thread. The setting stays with this
+    // object and is not copied or moved.
+    ReleasedNodes<Key, Value> release();
+    void clear_async();
+    void setBackgroundClear(bool background);
+    bool isBackgroundClear() const;
 
     template<typename PPKey, typename PPValue>
     friend void prettyPrintBST(BinarySearchTree<PPKey, PPValue> & tree);
@@ -231,12 +379,13 @@ public:
     iterator begin() const;
     iterator end() const;
     iterator find(const Key& key) const;
+    iterator lower_bound(const Key& key) const;
     Value& operator[](const Key& key);
     Value const & operator[](const Key& key) const;
 
 protected:
     // Mandatory helper functions
-    Node<Key, Value>* internalFind(const Key& k) const; // TODO
+    virtual Node<Key, Value>* internalFind(const Key& k) const; // TODO
     Node<Key, Value> *getSmallestNode() const;  // TODO
     static Node<Key, Value>* predecessor(Node<Key, Value>* current); // TODO
     // Note:  static means these functions don't have a "this" pointer
@@ -249,11 +398,36 @@ protected:
     // Add helper functions here
     int calculateHeightIfBalanced(Node<Key, Value>* root) const;
     static void successor(Node<Key, Value>*& current); 
-    int leafDelete(Node<Key, Value>* const root);
+    static void splitAt(Node<Key, Value>* root, const Key& key, bool inclusive,
+                        Node<Key, Value>*& lower, Node<Key, Value>*& upper);
+    static size_t destroySubtree(Node<Key, Value>* root);
+    static size_t countNodes(Node<Key, Value>* root);
+    iterator iteratorAt(Node<Key, Value>* n) const;
+
+    // Copy helpers. Trees with their own node type override cloneNode.
+    virtual Node<Key, Value>* cloneNode(const Node<Key, Value>* src, Node<Key, Value>* parent) const;
+    void copyFrom(const BinarySearchTree<Key, Value>& other);
+    Node<Key, Value>* copySubtree(const Node<Key, Value>* src, Node<Key, Value>* parent, int depth) const;
+    static int parallelDepth();
+    int passDepth() const;
+    static Node<Key, Value>* nextInSubtree(Node<Key, Value>* curr, Node<Key, Value>* root);
+    template<typename F>
+    static void visitSubtree(Node<Key, Value>* root, F& f);
+    template<typename F>
+    static void parallelVisit(Node<Key, Value>* root, int depth, F& f, TaskGroup& group);
+    template<typename T, typename Map, typename Combine>
+    static T foldSubtree(Node<Key, Value>* root, int depth, Map& map, Combine& combine);
+
+    // Rotations shared by the self-balancing trees. They keep root_ and all
+    // parent pointers up to date but touch no per-node balance data.
+    void rotateLeft(Node<Key, Value>* n);
+    void rotateRight(Node<Key, Value>* n);
+    static Node<Key, Value>* nodeAt(const iterator& it);
 
 protected:
     Node<Key, Value>* root_;
-    // You should not need other data members
+    size_t size_;   // number of nodes, kept exact by every operation that adds or frees one
+    bool backgroundClear_;
 };
 
 /*
@@ -312,10 +486,9 @@ BinarySearchTree<Key, Value>::iterator::operator==(
     const BinarySearchTree<Key, Value>::iterator& rhs) const
 {
     // TODO
-    if (this->current_ == NULL && rhs.current_ == NULL) return true; 
-    else if (this->current_ == NULL || rhs.current_ == NULL) return false; 
-    if (this->current_->getKey() == rhs.current_->getKey() && this->current_->getValue() == rhs.current_->getValue()) return true;
-    else return false; 
+    // iterators are equal when they sit on the same node; comparing the
+    // items would confuse distinct nodes that hold equal keys and values
+    return this->current_ == rhs.current_; 
 }
 
 /**
@@ -366,8 +539,39 @@ BinarySearchTree<Key, Value>::BinarySearchTree()
 {
     // TODO
     root_ = NULL; 
+    size_ = 0; 
+    backgroundClear_ = false;
+}
+
+/**
+* Copy constructor. Mirrors the other tree's shape node for node, with no
+* re-insertion.
+*/
+template<class Key, class Value>
+BinarySearchTree<Key, Value>::BinarySearchTree(const BinarySearchTree<Key, Value>& other) :
+    root_(NULL),
+    size_(0),
+    backgroundClear_(false)
+{
+    copyFrom(other);
+}
+
+/**
+* Move constructor, which takes over the other tree's nodes.
+*/
+template<class Key, class Value>
+BinarySearchTree<Key, Value>::BinarySearchTree(BinarySearchTree<Key, Value>&& other) :
+    root_(other.root_),
+    size_(other.size_),
+    backgroundClear_(false)
+{
+    other.root_ = NULL;
+    other.size_ = 0;
 }
 
+/*
+* Frees the nodes here, or on the reclaimer thread with setBackgroundClear.
+*/
 template<typename Key, typename Value>
 BinarySearchTree<Key, Value>::~BinarySearchTree()
 {
@@ -375,6 +579,42 @@ BinarySearchTree<Key, Value>::~BinarySearchTree()
     clear(); 
 }
 
+template<class Key, class Value>
+BinarySearchTree<Key, Value>&
+BinarySearchTree<Key, Value>::operator=(const BinarySearchTree<Key, Value>& other)
+{
+    if (this != &other)
+    {
+      clear();
+      copyFrom(other);
+    }
+    return *this;
+}
+
+template<class Key, class Value>
+BinarySearchTree<Key, Value>&
+BinarySearchTree<Key, Value>::operator=(BinarySearchTree<Key, Value>&& other)
+{
+    if (this != &other)
+    {
+      clear();
+      root_ = other.root_;
+      size_ = other.size_;
+      other.root_ = NULL;
+      other.size_ = 0;
+    }
+    return *this;
+}
+
+/**
+ * Returns the number of items in the tree in O(1)
+*/
+template<class Key, class Value>
+size_t BinarySearchTree<Key, Value>::size() const
+{
+    return size_;
+}
+
 /**
  * Returns true if tree is empty
 */
@@ -413,6 +653,25 @@ BinarySearchTree<Key, Value>::end() const
     return end;
 }
 
+/**
+* Lets derived trees build iterators from their own nodes.
+*/
+template<class Key, class Value>
+typename BinarySearchTree<Key, Value>::iterator
+BinarySearchTree<Key, Value>::iteratorAt(Node<Key, Value>* n) const
+{
+    return iterator(n);
+}
+
+/**
+* Lets derived trees see which node an iterator points at.
+*/
+template<class Key, class Value>
+Node<Key, Value>* BinarySearchTree<Key, Value>::nodeAt(const iterator& it)
+{
+    return it.current_;
+}
+
 /**
 * Returns an iterator to the item with the given key, k
 * or the end iterator if k does not exist in the tree
@@ -426,6 +685,27 @@ BinarySearchTree<Key, Value>::find(const Key & k) const
     return it;
 }
 
+/**
+* Returns an iterator to the first item whose key is not less than key, or
+* end() if there is none. One descent, O(height).
+*/
+template<class Key, class Value>
+typename BinarySearchTree<Key, Value>::iterator
+BinarySearchTree<Key, Value>::lower_bound(const Key& key) const
+{
+    Node<Key, Value>* best = NULL;
+    for (Node<Key, Value>* n = root_; n != NULL; )
+    {
+      if (n->getKey() < key) n = n->getRight();
+      else
+      {
+        best = n;
+        n = n->getLeft();
+      }
+    }
+    return iterator(best);
+}
+
 /**
  * @precondition The key exists in the map
  * Returns the value associated with the key
@@ -460,6 +740,7 @@ void BinarySearchTree<Key, Value>::insert(const std::pair<const Key, Value> &key
     {
       Node<Key, Value>* newNode = new Node<Key, Value>(keyValuePair.first, keyValuePair.second, NULL);
       root_ = newNode; 
+      size_++; 
     }
     else
     {
@@ -477,6 +758,7 @@ void BinarySearchTree<Key, Value>::insert(const std::pair<const Key, Value> &key
           {
             Node<Key, Value>* newNode = new Node<Key, Value>(keyValuePair.first, keyValuePair.second, traveler); 
             traveler->setLeft(newNode); 
+            size_++; 
             break; 
           }
           traveler = traveler->getLeft(); 
@@ -494,6 +776,7 @@ void BinarySearchTree<Key, Value>::insert(const std::pair<const Key, Value> &key
           {
             Node<Key, Value>* newNode = new Node<Key, Value>(keyValuePair.first, keyValuePair.second, traveler); 
             traveler->setRight(newNode); 
+            size_++; 
             break;
           }
           traveler = traveler->getRight(); 
@@ -516,8 +799,9 @@ void BinarySearchTree<Key, Value>::remove(const Key& key)
     
     // if the value is not found we stop 
     if (removal == NULL) return; 
+    size_--; 
     // 0 child case --> left and right children are NULL
-    else if (removal->getRight() == NULL && removal->getLeft() == NULL)
+    if (removal->getRight() == NULL && removal->getLeft() == NULL)
     {
       if (removal == root_) 
       {
@@ -723,98 +1007,484 @@ void BinarySearchTree<Key, Value>::successor(Node<Key, Value>*& current)
     }
     else
     {
-      // no parent means we are at the root, so no successor
-      // the error is somewhere here 
-      if (temp->getParent() == NULL)
+      // with no right subtree, the successor is the first ancestor we reach
+      // from its left side; climbing off the root means there is none 
+      Node<Key, Value>* parent = temp->getParent(); 
+      while (parent != NULL && parent->getRight() == temp)
       {
-        if (temp->getLeft() == NULL && temp->getRight() == NULL)
-        {
-          current = NULL; 
-        }
-        else 
-        {
-          current = temp; 
-        }
-        return; 
-      }
-      // if there is a parent, is there a grandparent? 
-      else 
-      {
-        // there is no grandparent, so we check if temp is a left or right child 
-        if (temp->getParent()->getParent() == NULL)
-        {
-          if (temp->getParent()->getLeft() == temp)
-          {
-            current = temp->getParent(); 
-            return; 
-          }
-          else if (temp->getParent()->getRight() == temp)
-          {
-            current = NULL;
-            return; 
-          }
-        }
-        // a grandparent exists so now we can look for a parent that is a left child of grandparent 
-        else
-        {
-          Node<Key, Value>* grandParent = temp->getParent()->getParent(); 
-          Node<Key, Value>* parent = temp->getParent(); 
-          // if no right child and temp is a left node, we climb the tree looking for first left node 
-            while (grandParent != NULL)
-            {
-              if (grandParent->getLeft() == parent)
-              {
-                current = grandParent; 
-                return; 
-              }
-              parent = parent->getParent();
-              grandParent = grandParent->getParent(); 
-            }
-            // no successor if we climb the tree and do not find anyone who is a left child. 
-            current = NULL; 
-        }
+        temp = parent; 
+        parent = parent->getParent(); 
       }
+      current = parent; 
     }
 }
 
 /**
 * A method to remove all contents of the tree and
 * reset the values in the tree for use again.
+* Subclasses extend it to reset their own bookkeeping.
 */
 template<typename Key, typename Value>
 void BinarySearchTree<Key, Value>::clear()
 {
     // TODO
-    leafDelete(root_); 
+    if (backgroundClear_) BackgroundReclaimer::submit(root_, &ReleasedNodes<Key, Value>::freeSlice);
+    else destroySubtree(root_);
     root_ = NULL; 
+    size_ = 0; 
 }
 
-/* Helper function to recursively reach leaf nodes and delete them */ 
+/*
+* Detaches every node and returns them for the caller to free. The tree is
+* left empty, with clear() run over it so subclasses reset their state too.
+*/
 template<typename Key, typename Value>
-int BinarySearchTree<Key, Value>::leafDelete(Node<Key, Value>* root)
+ReleasedNodes<Key, Value> BinarySearchTree<Key, Value>::release()
 {
-    // TODO
-    // if we go past a leaf node we need to stop 
-    if (root == nullptr) return 0; 
-    
-    // doing the recursion in an if statement so that we stop the recursion and return a -1 if at anypoint the leaf is different than depth 
-    leafDelete(root->getLeft());
-    leafDelete(root->getRight());
-    
-    // only act on the nodes once we have reached a leaf 
-    if (root->getLeft() == NULL and root->getRight() == NULL)
+    ReleasedNodes<Key, Value> released(root_);
+    root_ = NULL;
+    size_ = 0;
+    clear();
+    return released;
+}
+
+/*
+* Empties the tree in O(1), leaving the nodes to the background reclaimer.
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::clear_async()
+{
+    release().reclaimInBackground();
+}
+
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::setBackgroundClear(bool background)
+{
+    backgroundClear_ = background;
+}
+
+template<typename Key, typename Value>
+bool BinarySearchTree<Key, Value>::isBackgroundClear() const
+{
+    return backgroundClear_;
+}
+
+/**
+* Removes every key k with lo <= k <= hi. The tree is split into the keys
+* below lo, the range itself, and the keys above hi, the range is freed in
+* a single sweep, and the two outer pieces are rejoined. Runs in
+* O(height + k) where k is the number of keys removed.
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::erase(const Key& lo, const Key& hi)
+{
+    if (root_ == NULL || hi < lo) return;
+
+    Node<Key, Value>* lower = NULL;
+    Node<Key, Value>* rest = NULL;
+    Node<Key, Value>* range = NULL;
+    Node<Key, Value>* upper = NULL;
+    splitAt(root_, lo, false, lower, rest);
+    splitAt(rest, hi, true, range, upper);
+    size_ -= destroySubtree(range);
+
+    // every key in upper is larger than every key in lower, so upper can
+    // hang off the largest node of lower
+    if (lower == NULL)
     {
-      Node<Key, Value>* temp = root; 
-      temp = root->getParent(); 
-      // look at parent, if parent is NULL, return 0; 
-      if (temp == NULL) {}
-      // if there is a parent, we need to check which child is the one we are trying to delete 
-      else if (temp->getRight() == root) temp->setRight(NULL); 
-      else if (temp->getLeft() == root) temp->setLeft(NULL); 
-      
-      delete root; 
+      root_ = upper;
+    }
+    else
+    {
+      Node<Key, Value>* largest = lower;
+      while (largest->getRight() != NULL) largest = largest->getRight();
+      largest->setRight(upper);
+      if (upper != NULL) upper->setParent(largest);
+      root_ = lower;
+    }
+}
+
+/*
+* Splits the subtree at root into the nodes whose keys are below key (or at
+* most key when inclusive is set) and all the others, without allocating or
+* rebalancing. Walks a single root-to-leaf path.
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::splitAt(Node<Key, Value>* root, const Key& key, bool inclusive,
+                                           Node<Key, Value>*& lower, Node<Key, Value>*& upper)
+{
+    lower = NULL;
+    upper = NULL;
+    // the last node placed on each side, whose open child is where the
+    // next node of that side gets attached
+    Node<Key, Value>* lowerTail = NULL;
+    Node<Key, Value>* upperTail = NULL;
+
+    while (root != NULL)
+    {
+      bool goesLower = root->getKey() < key || (inclusive && root->getKey() == key);
+      if (goesLower)
+      {
+        if (lowerTail == NULL) lower = root;
+        else lowerTail->setRight(root);
+        root->setParent(lowerTail);
+        lowerTail = root;
+        root = root->getRight();
+      }
+      else
+      {
+        if (upperTail == NULL) upper = root;
+        else upperTail->setLeft(root);
+        root->setParent(upperTail);
+        upperTail = root;
+        root = root->getLeft();
+      }
+    }
+    if (lowerTail != NULL) lowerTail->setRight(NULL);
+    if (upperTail != NULL) upperTail->setLeft(NULL);
+}
+
+/*
+* Frees every node of the subtree at root and returns how many were freed.
+* Walks with the parent pointers instead of recursing, so degenerate trees
+* cannot overflow the stack.
+*/
+template<typename Key, typename Value>
+size_t BinarySearchTree<Key, Value>::destroySubtree(Node<Key, Value>* root)
+{
+    if (root == NULL) return 0;
+    Node<Key, Value>* top = root->getParent();
+    size_t freed = 0;
+    while (root != top)
+    {
+      if (root->getLeft() != NULL) root = root->getLeft();
+      else if (root->getRight() != NULL) root = root->getRight();
+      else
+      {
+        Node<Key, Value>* parent = root->getParent();
+        if (parent != top)
+        {
+          if (parent->getLeft() == root) parent->setLeft(NULL);
+          else parent->setRight(NULL);
+        }
+        delete root;
+        freed++;
+        root = parent;
+      }
+    }
+    return freed;
+}
+
+/*
+* Makes a copy of src attached to parent. Derived trees override this to copy
+* their own node type and per-node data.
+*/
+template<typename Key, typename Value>
+Node<Key, Value>* BinarySearchTree<Key, Value>::cloneNode(const Node<Key, Value>* src, Node<Key, Value>* parent) const
+{
+    return new Node<Key, Value>(src->getKey(), src->getValue(), parent);
+}
+
+// trees smaller than this are copied on the calling thread alone
+#define BST_PARALLEL_COPY_MIN_SIZE 32768
+
+/*
+* Replaces this (empty) tree with a structural copy of other.
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::copyFrom(const BinarySearchTree<Key, Value>& other)
+{
+    int depth = (other.size_ >= BST_PARALLEL_COPY_MIN_SIZE) ? 0 : parallelDepth();
+    root_ = copySubtree(other.root_, NULL, depth);
+    size_ = other.size_;
+}
+
+/*
+* Copies the subtree at src. The top parallelDepth() levels hand their left
+* subtree to the shared WorkStealingPool; below that the copy walks the
+* source with parent pointers, building each node as it is first reached,
+* so even a degenerate tree is copied without recursion.
+*/
+template<typename Key, typename Value>
+Node<Key, Value>* BinarySearchTree<Key, Value>::copySubtree(const Node<Key, Value>* src, Node<Key, Value>* parent, int depth) const
+{
+    if (src == NULL) return NULL;
+    Node<Key, Value>* copy = cloneNode(src, parent);
+
+    if (depth < parallelDepth())
+    {
+      Node<Key, Value>* left = NULL;
+      TaskGroup group(WorkStealingPool::shared());
+      group.spawn([&]() { left = copySubtree(src->getLeft(), copy, depth + 1); });
+      Node<Key, Value>* right = copySubtree(src->getRight(), copy, depth + 1);
+      group.wait();
+      copy->setLeft(left);
+      copy->setRight(right);
+      return copy;
+    }
+
+    const Node<Key, Value>* s = src;
+    Node<Key, Value>* d = copy;
+    while (true)
+    {
+      if (s->getLeft() != NULL && d->getLeft() == NULL)
+      {
+        d->setLeft(cloneNode(s->getLeft(), d));
+        s = s->getLeft();
+        d = d->getLeft();
+      }
+      else if (s->getRight() != NULL && d->getRight() == NULL)
+      {
+        d->setRight(cloneNode(s->getRight(), d));
+        s = s->getRight();
+        d = d->getRight();
+      }
+      else if (s == src)
+      {
+        break;
+      }
+      else
+      {
+        s = s->getParent();
+        d = d->getParent();
+      }
+    }
+    return copy;
+}
+
+/*
+* How many levels of a divide and conquer operation fork onto new threads:
+* enough to give every hardware thread its own piece of the work.
+*/
+template<typename Key, typename Value>
+int BinarySearchTree<Key, Value>::parallelDepth()
+{
+    static const int depth = []() {
+      unsigned threads = std::thread::hardware_concurrency();
+      int d = 0;
+      while ((1u << d) < threads) d++;
+      return d;
+    }();
+    return depth;
+}
+
+// trees smaller than this are passed over on the calling thread alone
+#define BST_PARALLEL_PASS_MIN_SIZE 16384
+
+/*
+* How many levels of a whole-tree pass split off tasks. Three more than
+* there are hardware threads to feed leaves about eight pieces per thread,
+* enough for stealing to even out subtrees of different sizes.
+*/
+template<typename Key, typename Value>
+int BinarySearchTree<Key, Value>::passDepth() const
+{
+    if (size_ < BST_PARALLEL_PASS_MIN_SIZE || WorkStealingPool::shared().workers() == 0) return 0;
+    return parallelDepth() + 3;
+}
+
+/*
+* The in-order successor of curr within the subtree at root, or NULL.
+*/
+template<typename Key, typename Value>
+Node<Key, Value>* BinarySearchTree<Key, Value>::nextInSubtree(Node<Key, Value>* curr, Node<Key, Value>* root)
+{
+    if (curr->getRight() != NULL)
+    {
+      curr = curr->getRight();
+      while (curr->getLeft() != NULL) curr = curr->getLeft();
+      return curr;
+    }
+    while (curr != root && curr->getParent()->getRight() == curr) curr = curr->getParent();
+    return curr == root ? NULL : curr->getParent();
+}
+
+/*
+* Calls f on every node of the subtree at root, in order, without
+* recursing.
+*/
+template<typename Key, typename Value>
+template<typename F>
+void BinarySearchTree<Key, Value>::visitSubtree(Node<Key, Value>* root, F& f)
+{
+    if (root == NULL) return;
+    Node<Key, Value>* curr = root;
+    while (curr->getLeft() != NULL) curr = curr->getLeft();
+    for (; curr != NULL; curr = nextInSubtree(curr, root)) f(curr);
+}
+
+/*
+* Calls f on every node of the subtree at root, in no particular order.
+* Walks down the left spine for depth levels, handing each right subtree
+* to the pool as it goes.
+*/
+template<typename Key, typename Value>
+template<typename F>
+void BinarySearchTree<Key, Value>::parallelVisit(Node<Key, Value>* root, int depth, F& f, TaskGroup& group)
+{
+    for (; root != NULL && depth > 0; --depth)
+    {
+      Node<Key, Value>* right = root->getRight();
+      if (right != NULL)
+      {
+        group.spawn([right, depth, &f, &group]() { parallelVisit(right, depth - 1, f, group); });
+      }
+      f(root);
+      root = root->getLeft();
+    }
+    visitSubtree(root, f);
+}
+
+/*
+* Folds the (non-empty) subtree at root in key order. The top depth levels
+* fold their right subtree on the pool while this thread does the left.
+*/
+template<typename Key, typename Value>
+template<typename T, typename Map, typename Combine>
+T BinarySearchTree<Key, Value>::foldSubtree(Node<Key, Value>* root, int depth, Map& map, Combine& combine)
+{
+    if (depth == 0)
+    {
+      Node<Key, Value>* curr = root;
+      while (curr->getLeft() != NULL) curr = curr->getLeft();
+      T acc = map(curr->getItem());
+      while ((curr = nextInSubtree(curr, root)) != NULL) acc = combine(acc, map(curr->getItem()));
+      return acc;
+    }
+
+    // declared before the group, which waits for the task when unwinding
+    std::unique_ptr<T> right;
+    TaskGroup group(WorkStealingPool::shared());
+    Node<Key, Value>* rightRoot = root->getRight();
+    if (rightRoot != NULL)
+    {
+      group.spawn([&right, rightRoot, depth, &map, &combine]() {
+        right.reset(new T(foldSubtree<T>(rightRoot, depth - 1, map, combine)));
+      });
+    }
+    T acc = map(root->getItem());
+    if (root->getLeft() != NULL) acc = combine(foldSubtree<T>(root->getLeft(), depth - 1, map, combine), acc);
+    group.wait();
+    if (right) acc = combine(acc, *right);
+    return acc;
+}
+
+/*
+* Calls f(item) on every item, with item a std::pair<const Key, Value>&.
+* Items are visited in no particular order.
+*/
+template<typename Key, typename Value>
+template<typename F>
+void BinarySearchTree<Key, Value>::parallel_for_each(F f)
+{
+    auto visit = [&f](Node<Key, Value>* n) { f(n->getItem()); };
+    TaskGroup group(WorkStealingPool::shared());
+    parallelVisit(root_, passDepth(), visit, group);
+    group.wait();
+}
+
+/*
+* Replaces every value with f(item).
+*/
+template<typename Key, typename Value>
+template<typename F>
+void BinarySearchTree<Key, Value>::parallel_transform_values(F f)
+{
+    auto visit = [&f](Node<Key, Value>* n) { n->setValue(f(n->getItem())); };
+    TaskGroup group(WorkStealingPool::shared());
+    parallelVisit(root_, passDepth(), visit, group);
+    group.wait();
+}
+
+/*
+* Returns init combined, in key order, with map(item) for every item:
+* combine(combine(init, map(first)), map(second)) and so on.
+*/
+template<typename Key, typename Value>
+template<typename T, typename Map, typename Combine>
+T BinarySearchTree<Key, Value>::parallel_reduce(T init, Map map, Combine combine) const
+{
+    if (root_ == NULL) return init;
+    return combine(init, foldSubtree<T>(root_, passDepth(), map, combine));
+}
+
+/*
+* Moves n's right child up into n's place, with n becoming its left child.
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::rotateLeft(Node<Key, Value>* n)
+{
+    Node<Key, Value>* rightNode = n->getRight();
+    Node<Key, Value>* p = n->getParent();
+
+    if (p == NULL) root_ = rightNode;
+    else if (p->getLeft() == n) p->setLeft(rightNode);
+    else p->setRight(rightNode);
+
+    n->setRight(rightNode->getLeft());
+    if (rightNode->getLeft() != NULL) rightNode->getLeft()->setParent(n);
+    rightNode->setLeft(n);
+    rightNode->setParent(p);
+    n->setParent(rightNode);
+}
+
+/*
+* Moves n's left child up into n's place, with n becoming its right child.
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::rotateRight(Node<Key, Value>* n)
+{
+    Node<Key, Value>* leftNode = n->getLeft();
+    Node<Key, Value>* p = n->getParent();
+
+    if (p == NULL) root_ = leftNode;
+    else if (p->getLeft() == n) p->setLeft(leftNode);
+    else p->setRight(leftNode);
+
+    n->setLeft(leftNode->getRight());
+    if (leftNode->getRight() != NULL) leftNode->getRight()->setParent(n);
+    leftNode->setRight(n);
+    leftNode->setParent(p);
+    n->setParent(leftNode);
+}
+
+/*
+* Counts the nodes of the subtree at root, walking it with the parent
+* pointers instead of recursing.
+*/
+template<typename Key, typename Value>
+size_t BinarySearchTree<Key, Value>::countNodes(Node<Key, Value>* root)
+{
+    if (root == NULL) return 0;
+    Node<Key, Value>* top = root->getParent();
+    size_t count = 0;
+    Node<Key, Value>* prev = top;
+    Node<Key, Value>* n = root;
+    while (n != top)
+    {
+      Node<Key, Value>* next;
+      // arriving from above: count it, then head down
+      if (prev == n->getParent())
+      {
+        count++;
+        if (n->getLeft() != NULL) next = n->getLeft();
+        else if (n->getRight() != NULL) next = n->getRight();
+        else next = n->getParent();
+      }
+      // back from the left subtree: the right one is next
+      else if (prev == n->getLeft() && n->getRight() != NULL)
+      {
+        next = n->getRight();
+      }
+      // both subtrees done
+      else
+      {
+        next = n->getParent();
+      }
+      prev = n;
+      n = next;
     }
-    return 0;
+    return count;
 }
 
 /**
@@ -0,0 +1,406 @@
+#ifndef CONCURRENTAVL_H
+#define CONCURRENTAVL_H
+
+#include <iostream>
+#include <exception>
+#include <cstdlib>
+#include <cstdint>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include "epoch.h"
+
+/*
+ * A node of the concurrent tree. Readers only touch the key, the value
+ * pointer, the children and the version; parent_ and height_ belong to the
+ * writer. The key never changes once the node is published.
+ *
+ * version_ is the node's optimistic lock. It steps by versionStep whenever
+ * the range of keys below the node shrinks, which only a rotation that
+ * moves the node down can do, with the changing bit set while the rotation
+ * is under way. The unlinked bit is set for good once the node leaves the
+ * tree.
+ */
+template <class Key, class Value>
+struct ConcurrentAVLNode
+{
+    static const uint64_t changing = 1;
+    static const uint64_t unlinked = 2;
+    static const uint64_t versionStep = 4;
+
+    ConcurrentAVLNode(const Key& key, Value* value, ConcurrentAVLNode<Key, Value>* parent) :
+        key_(key), value_(value), version_(0), left_(NULL), right_(NULL), parent_(parent), height_(1) { }
+    ~ConcurrentAVLNode() { delete value_.load(); }
+
+    ConcurrentAVLNode<Key, Value>* child(bool right) const
+    {
+      return right ? right_.load() : left_.load();
+    }
+    void setChild(bool right, ConcurrentAVLNode<Key, Value>* child)
+    {
+      if (right) right_.store(child);
+      else left_.store(child);
+    }
+
+    const Key key_;
+    // NULL once the key is removed while the node still routes searches
+    std::atomic<Value*> value_;
+    std::atomic<uint64_t> version_;
+    std::atomic<ConcurrentAVLNode<Key, Value>*> left_;
+    std::atomic<ConcurrentAVLNode<Key, Value>*> right_;
+    ConcurrentAVLNode<Key, Value>* parent_;
+    int height_;
+};
+
+/**
+* An AVL tree that any number of threads may use at once, built for
+* read-mostly workloads. Lookups take no locks and write nothing shared:
+* they descend by optimistic lock coupling, reading each node's version
+* before following a child and checking it again after, and go back up a
+* level whenever a rotation has shrunk the range below a node they passed
+* (after Bronson, Casper, Chafi and Olukotun's relaxed-balance tree).
+*
+* Writers take one mutex between them, so updates run one at a time while
+* lookups carry on around them. Removing a key whose node has two children
+* only drops the value; the node keeps routing searches until a later
+* update finds it with one child and unlinks it. Unlinked nodes and
+* replaced values are freed through an EpochReclaimer once no lookup can
+* still see them.
+*
+* Lookups copy the value out, since a reference could outlive the item.
+*/
+template <class Key, class Value>
+class ConcurrentAVLTree
+{
+public:
+    ConcurrentAVLTree();
+    ~ConcurrentAVLTree();
+
+    void insert(const std::pair<const Key, Value>& keyValuePair);
+    void remove(const Key& key);
+    bool find(const Key& key, Value& value) const;
+    bool contains(const Key& key) const;
+    void clear();
+    size_t size() const;
+    bool empty() const;
+
+protected:
+    typedef ConcurrentAVLNode<Key, Value> Node;
+    enum Outcome {found, notFound, retry};
+
+    Outcome attemptFind(const Key& key, const Node* node, bool right, uint64_t nodeVersion, Value* value) const;
+    static uint64_t stableVersion(const Node* node);
+    Node* internalFind(const Key& key) const;
+    void unlink(Node* node);
+    void rotate(Node* node, bool left);
+    void fixFrom(Node* node);
+    static int height(const Node* node);
+    static void updateHeight(Node* node);
+
+    ConcurrentAVLTree(const ConcurrentAVLTree<Key, Value>&);
+    ConcurrentAVLTree<Key, Value>& operator=(const ConcurrentAVLTree<Key, Value>&);
+
+    // the root hangs off holder_'s right; holder_'s version never changes
+    Node holder_;
+    std::mutex writeLock_;
+    mutable EpochReclaimer reclaimer_;
+    std::atomic<size_t> size_;
+};
+
+
+template<class Key, class Value>
+ConcurrentAVLTree<Key, Value>::ConcurrentAVLTree() : holder_(Key(), NULL, NULL), size_(0)
+{
+
+}
+
+/*
+ * No other thread may be using the tree.
+ */
+template<class Key, class Value>
+ConcurrentAVLTree<Key, Value>::~ConcurrentAVLTree()
+{
+    std::vector<Node*> stack;
+    if (holder_.right_.load() != NULL) stack.push_back(holder_.right_.load());
+    while (!stack.empty())
+    {
+      Node* curr = stack.back();
+      stack.pop_back();
+      if (curr->left_.load() != NULL) stack.push_back(curr->left_.load());
+      if (curr->right_.load() != NULL) stack.push_back(curr->right_.load());
+      delete curr;
+    }
+}
+
+/*
+ * Recall: If key is already in the tree, you should
+ * overwrite the current value with the updated value.
+ */
+template<class Key, class Value>
+void ConcurrentAVLTree<Key, Value>::insert(const std::pair<const Key, Value>& keyValuePair)
+{
+    Value* value = new Value(keyValuePair.second);
+    std::lock_guard<std::mutex> guard(writeLock_);
+    const Key& key = keyValuePair.first;
+    Node* parent = &holder_;
+    bool right = true;
+    Node* curr = holder_.right_.load();
+    while (curr != NULL)
+    {
+      if (!(key < curr->key_) && !(curr->key_ < key))
+      {
+        Value* old = curr->value_.exchange(value);
+        if (old == NULL) size_++;
+        else reclaimer_.retire(old);
+        return;
+      }
+      parent = curr;
+      right = curr->key_ < key;
+      curr = curr->child(right);
+    }
+    parent->setChild(right, new Node(key, value, parent));
+    size_++;
+    fixFrom(parent);
+}
+
+template<class Key, class Value>
+void ConcurrentAVLTree<Key, Value>::remove(const Key& key)
+{
+    std::lock_guard<std::mutex> guard(writeLock_);
+    Node* curr = internalFind(key);
+    if (curr == NULL || curr->value_.load() == NULL) return;
+    size_--;
+    if (curr->left_.load() != NULL && curr->right_.load() != NULL)
+    {
+      reclaimer_.retire(curr->value_.exchange(NULL));
+      return;
+    }
+    Node* parent = curr->parent_;
+    unlink(curr);
+    fixFrom(parent);
+}
+
+/*
+ * Copies the value for key into value and returns true, or returns false
+ * if the key is absent. Never blocks on a writer except to let a rotation
+ * of a node in its path finish.
+ */
+template<class Key, class Value>
+bool ConcurrentAVLTree<Key, Value>::find(const Key& key, Value& value) const
+{
+    EpochGuard guard(reclaimer_);
+    Outcome outcome;
+    do
+    {
+      outcome = attemptFind(key, &holder_, true, holder_.version_.load(), &value);
+    } while (outcome == retry);
+    return outcome == found;
+}
+
+template<class Key, class Value>
+bool ConcurrentAVLTree<Key, Value>::contains(const Key& key) const
+{
+    EpochGuard guard(reclaimer_);
+    Outcome outcome;
+    do
+    {
+      outcome = attemptFind(key, &holder_, true, holder_.version_.load(), NULL);
+    } while (outcome == retry);
+    return outcome == found;
+}
+
+/*
+ * Searches the subtree on the given side of node, which was seen at
+ * nodeVersion. Returns retry if node has since shrunk or left the tree, so
+ * the caller can look again from one level up.
+ */
+template<class Key, class Value>
+typename ConcurrentAVLTree<Key, Value>::Outcome
+ConcurrentAVLTree<Key, Value>::attemptFind(const Key& key, const Node* node, bool right,
+                                           uint64_t nodeVersion, Value* value) const
+{
+    while (true)
+    {
+      const Node* child = node->child(right);
+      if (node->version_.load() != nodeVersion) return retry;
+      if (child == NULL) return notFound;
+      if (!(key < child->key_) && !(child->key_ < key))
+      {
+        const Value* item = child->value_.load();
+        if (item == NULL) return notFound;
+        if (value != NULL) *value = *item;
+        return found;
+      }
+
+      uint64_t childVersion = stableVersion(child);
+      // the child was rotated away or unlinked while we waited
+      if ((childVersion & Node::unlinked) || child != node->child(right)) continue;
+      if (node->version_.load() != nodeVersion) return retry;
+      Outcome outcome = attemptFind(key, child, child->key_ < key, childVersion, value);
+      if (outcome != retry) return outcome;
+    }
+}
+
+/*
+ * The node's version once no rotation is moving it.
+ */
+template<class Key, class Value>
+uint64_t ConcurrentAVLTree<Key, Value>::stableVersion(const Node* node)
+{
+    uint64_t version = node->version_.load();
+    while (version & Node::changing)
+    {
+      std::this_thread::yield();
+      version = node->version_.load();
+    }
+    return version;
+}
+
+/*
+ * Removes every item. Lookups already under way may still see the old
+ * items; the nodes are freed once they finish.
+ */
+template<class Key, class Value>
+void ConcurrentAVLTree<Key, Value>::clear()
+{
+    std::lock_guard<std::mutex> guard(writeLock_);
+    std::vector<Node*> stack;
+    if (holder_.right_.load() != NULL) stack.push_back(holder_.right_.load());
+    holder_.setChild(true, NULL);
+    size_ = 0;
+    while (!stack.empty())
+    {
+      Node* curr = stack.back();
+      stack.pop_back();
+      if (curr->left_.load() != NULL) stack.push_back(curr->left_.load());
+      if (curr->right_.load() != NULL) stack.push_back(curr->right_.load());
+      reclaimer_.retire(curr);
+    }
+}
+
+template<class Key, class Value>
+size_t ConcurrentAVLTree<Key, Value>::size() const
+{
+    return size_.load(std::memory_order_relaxed);
+}
+
+template<class Key, class Value>
+bool ConcurrentAVLTree<Key, Value>::empty() const
+{
+    return size() == 0;
+}
+
+/*
+ * Finds the node for key, value or not. Writers only.
+ */
+template<class Key, class Value>
+ConcurrentAVLNode<Key, Value>* ConcurrentAVLTree<Key, Value>::internalFind(const Key& key) const
+{
+    Node* curr = holder_.right_.load();
+    while (curr != NULL)
+    {
+      if (key < curr->key_) curr = curr->left_.load();
+      else if (curr->key_ < key) curr = curr->right_.load();
+      else return curr;
+    }
+    return NULL;
+}
+
+/*
+ * Splices out a node with at most one child and retires it. The node keeps
+ * its children, so a lookup already inside it still finds its way down.
+ */
+template<class Key, class Value>
+void ConcurrentAVLTree<Key, Value>::unlink(Node* node)
+{
+    Node* parent = node->parent_;
+    Node* child = node->left_.load() != NULL ? node->left_.load() : node->right_.load();
+    parent->setChild(parent->right_.load() == node, child);
+    if (child != NULL) child->parent_ = parent;
+    node->version_.store(node->version_.load() | Node::unlinked);
+    reclaimer_.retire(node);
+}
+
+/*
+ * Rotates node down to the left (its right child comes up) or to the
+ * right. Lookups that reach node meanwhile wait for the changing bit to
+ * clear; those already past it notice the new version and back up.
+ */
+template<class Key, class Value>
+void ConcurrentAVLTree<Key, Value>::rotate(Node* node, bool left)
+{
+    uint64_t version = node->version_.load();
+    node->version_.store(version | Node::changing);
+
+    Node* parent = node->parent_;
+    bool nodeRight = parent->right_.load() == node;
+    Node* up = node->child(left);
+    Node* inner = up->child(!left);
+
+    node->setChild(left, inner);
+    if (inner != NULL) inner->parent_ = node;
+    up->setChild(!left, node);
+    node->parent_ = up;
+    parent->setChild(nodeRight, up);
+    up->parent_ = parent;
+    updateHeight(node);
+    updateHeight(up);
+
+    node->version_.store(version + Node::versionStep);
+}
+
+/*
+ * Walks from node to the root, unlinking routing nodes that are down to one
+ * child, refreshing heights and rotating where a subtree is out of balance.
+ */
+template<class Key, class Value>
+void ConcurrentAVLTree<Key, Value>::fixFrom(Node* node)
+{
+    while (node != &holder_)
+    {
+      Node* parent = node->parent_;
+      if (node->value_.load() == NULL && (node->left_.load() == NULL || node->right_.load() == NULL))
+      {
+        unlink(node);
+        node = parent;
+        continue;
+      }
+
+      int balance = height(node->right_.load()) - height(node->left_.load());
+      if (balance > 1)
+      {
+        Node* right = node->right_.load();
+        if (height(right->left_.load()) > height(right->right_.load())) rotate(right, false);
+        rotate(node, true);
+      }
+      else if (balance < -1)
+      {
+        Node* left = node->left_.load();
+        if (height(left->right_.load()) > height(left->left_.load())) rotate(left, true);
+        rotate(node, false);
+      }
+      else
+      {
+        updateHeight(node);
+      }
+      node = parent;
+    }
+}
+
+template<class Key, class Value>
+int ConcurrentAVLTree<Key, Value>::height(const Node* node)
+{
+    return node == NULL ? 0 : node->height_;
+}
+
+template<class Key, class Value>
+void ConcurrentAVLTree<Key, Value>::updateHeight(Node* node)
+{
+    node->height_ = 1 + std::max(height(node->left_.load()), height(node->right_.load()));
+}
+
+
+#endif
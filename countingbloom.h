@@ -0,0 +1,162 @@
+#ifndef COUNTINGBLOOM_H
+#define COUNTINGBLOOM_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+#include <utility>
+#include <functional>
+
+/**
+* Says whether std::hash can hash Key, so that a tree can offer a filter
+* without requiring every key type to be hashable.
+*/
+template <class Key, class Enable = void>
+struct FilterHash
+{
+    static const bool available = false;
+    static size_t hash(const Key&) { return 0; }
+};
+
+template <class Key>
+struct FilterHash<Key, decltype(void(std::hash<Key>()(std::declval<const Key&>())))>
+{
+    static const bool available = true;
+    static size_t hash(const Key& key) { return std::hash<Key>()(key); }
+};
+
+/**
+* A blocked counting Bloom filter. Each key maps to one 64-byte block of 128
+* four-bit counters and bumps four of them, so a query reads one block, one
+* or two cache lines. Counters make removal possible. A counter that hits
+* 15 sticks there, which can only cause false positives, never false
+* negatives.
+*
+* It holds about 12 keys per block, which keeps false positives near 1% at
+* its capacity.
+*/
+template <class Key>
+class CountingBloomFilter
+{
+public:
+    CountingBloomFilter(size_t capacity);
+
+    void add(const Key& key);
+    void remove(const Key& key);
+    bool mayContain(const Key& key) const;
+    void clear();
+    size_t capacity() const;
+
+protected:
+    static uint64_t mix(const Key& key);
+    uint64_t* blockFor(uint64_t h);
+    const uint64_t* blockFor(uint64_t h) const;
+
+    // eight words, 128 counters, per block
+    std::vector<uint64_t> words_;
+    size_t blockMask_;
+    size_t capacity_;
+};
+
+template<class Key>
+CountingBloomFilter<Key>::CountingBloomFilter(size_t capacity) : blockMask_(0), capacity_(0)
+{
+    size_t blocks = 1;
+    while (blocks * 12 < capacity) blocks *= 2;
+    words_.assign(blocks * 8, 0);
+    blockMask_ = blocks - 1;
+    capacity_ = blocks * 12;
+}
+
+/*
+ * Scrambles std::hash, which is the identity for integers on most
+ * libraries. The high half picks the block and the low 28 bits pick four
+ * counters in it.
+ */
+template<class Key>
+uint64_t CountingBloomFilter<Key>::mix(const Key& key)
+{
+    uint64_t h = FilterHash<Key>::hash(key);
+    h += 0x9e3779b97f4a7c15ULL;
+    h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+    return h ^ (h >> 31);
+}
+
+template<class Key>
+uint64_t* CountingBloomFilter<Key>::blockFor(uint64_t h)
+{
+    return &words_[((h >> 32) & blockMask_) * 8];
+}
+
+template<class Key>
+const uint64_t* CountingBloomFilter<Key>::blockFor(uint64_t h) const
+{
+    return &words_[((h >> 32) & blockMask_) * 8];
+}
+
+template<class Key>
+void CountingBloomFilter<Key>::add(const Key& key)
+{
+    uint64_t h = mix(key);
+    uint64_t* block = blockFor(h);
+    for (int i = 0; i < 4; ++i)
+    {
+      unsigned counter = (h >> (7 * i)) & 127;
+      uint64_t& word = block[counter / 16];
+      unsigned shift = (counter % 16) * 4;
+      if (((word >> shift) & 15) != 15) word += uint64_t(1) << shift;
+    }
+}
+
+template<class Key>
+void CountingBloomFilter<Key>::remove(const Key& key)
+{
+    uint64_t h = mix(key);
+    uint64_t* block = blockFor(h);
+    for (int i = 0; i < 4; ++i)
+    {
+      unsigned counter = (h >> (7 * i)) & 127;
+      uint64_t& word = block[counter / 16];
+      unsigned shift = (counter % 16) * 4;
+      uint64_t value = (word >> shift) & 15;
+      // a saturated counter has lost track of how many keys it holds
+      if (value != 0 && value != 15) word -= uint64_t(1) << shift;
+    }
+}
+
+/*
+ * False means the key was never added (or has been removed); true means it
+ * probably was.
+ */
+template<class Key>
+bool CountingBloomFilter<Key>::mayContain(const Key& key) const
+{
+    uint64_t h = mix(key);
+    const uint64_t* block = blockFor(h);
+    for (int i = 0; i < 4; ++i)
+    {
+      unsigned counter = (h >> (7 * i)) & 127;
+      if (((block[counter / 16] >> ((counter % 16) * 4)) & 15) == 0) return false;
+    }
+    return true;
+}
+
+template<class Key>
+void CountingBloomFilter<Key>::clear()
+{
+    std::fill(words_.begin(), words_.end(), 0);
+}
+
+/*
+ * How many keys the filter is sized for.
+ */
+template<class Key>
+size_t CountingBloomFilter<Key>::capacity() const
+{
+    return capacity_;
+}
+
+
+#endif
@@ -0,0 +1,271 @@
+#ifndef EPOCH_H
+#define EPOCH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <utility>
+#include <functional>
+
+/**
+* Epoch-based reclamation for structures whose readers take no locks. A
+* reader wraps each operation in an EpochGuard. A writer that unlinks
+* something hands it to retire() instead of deleting it, and it is freed
+* once every reader that might still hold a pointer to it has left.
+*
+* The global epoch only moves from e to e + 1 once every reader inside a
+* guard has announced e, so anything retired during epoch e is unreachable
+* to all readers by the time the epoch reaches e + 2. Retired objects wait
+* in one of three lists, by epoch mod 3.
+*
+* Readers announce themselves in a fixed table of slots, each on its own
+* cache line, so entering and leaving a guard touches no shared line in the
+* common case. A slot counts the guards holding it, and a thread that
+* already holds one joins it again, so nested guards and any number of
+* iterators cost one slot per thread. A guard may be closed on another
+* thread than the one that opened it. When every slot is taken a new
+* reader shares one with another thread instead of waiting: a slot never
+* announces an epoch newer than the global one, so joining it is as safe
+* as announcing that older epoch would be. Any number of guards can
+* therefore be open at once; a long-lived one still holds up reclamation.
+*/
+class EpochReclaimer
+{
+public:
+    static const size_t maxReaders = 64;
+    static const size_t cacheLine = 64;
+
+    EpochReclaimer();
+    ~EpochReclaimer();
+
+    template <class T>
+    void retire(T* object);
+    void retire(void* object, void (*deleter)(void*));
+    void collect();
+    size_t pending() const;
+
+protected:
+    friend class EpochGuard;
+
+    struct Slot
+    {
+      // the epoch the first of its readers entered in, or 0 when free
+      std::atomic<uint64_t> epoch_;
+      // open guards sharing the slot; the last one out frees it
+      std::atomic<size_t> holders_;
+      char pad_[cacheLine - sizeof(std::atomic<uint64_t>) - sizeof(std::atomic<size_t>)];
+    };
+    // the slot this thread last held in one reclaimer
+    struct Hint
+    {
+      const EpochReclaimer* reclaimer_;
+      size_t slot_;
+    };
+    static const size_t hintCount = 4;
+    struct Retired
+    {
+      void* object_;
+      void (*deleter_)(void*);
+    };
+
+    size_t enter();
+    bool join(size_t slot);
+    void leave(size_t slot);
+    bool tryAdvance();
+    void freeList(std::vector<Retired>& list);
+
+    template <class T>
+    static void deleteObject(void* object) { delete static_cast<T*>(object); }
+
+    EpochReclaimer(const EpochReclaimer&);
+    EpochReclaimer& operator=(const EpochReclaimer&);
+
+    // slots_ starts at the first line boundary in slotStorage_, since the
+    // reclaimer itself may sit anywhere (new only promises 16 bytes)
+    char slotStorage_[(maxReaders + 1) * cacheLine];
+    Slot* slots_;
+    std::atomic<uint64_t> epoch_;
+    mutable std::mutex retireLock_;
+    std::vector<Retired> retired_[3];
+    size_t sinceCollect_;
+};
+
+/**
+* Keeps the calling thread inside the reclaimer's current epoch until the
+* end of the scope. Pointers read from the structure stay valid until then.
+*/
+class EpochGuard
+{
+public:
+    EpochGuard(EpochReclaimer& reclaimer) : reclaimer_(reclaimer), slot_(reclaimer.enter()) { }
+    ~EpochGuard() { reclaimer_.leave(slot_); }
+private:
+    EpochGuard(const EpochGuard&);
+    EpochGuard& operator=(const EpochGuard&);
+    EpochReclaimer& reclaimer_;
+    size_t slot_;
+};
+
+
+inline EpochReclaimer::EpochReclaimer() : epoch_(1), sinceCollect_(0)
+{
+    static_assert(sizeof(Slot) == cacheLine, "a reader slot must fill one cache line");
+    uintptr_t storage = reinterpret_cast<uintptr_t>(slotStorage_);
+    slots_ = reinterpret_cast<Slot*>((storage + cacheLine - 1) & ~(uintptr_t)(cacheLine - 1));
+    for (size_t i = 0; i < maxReaders; ++i)
+    {
+      new (&slots_[i]) Slot();
+      slots_[i].epoch_.store(0, std::memory_order_relaxed);
+      slots_[i].holders_.store(0, std::memory_order_relaxed);
+    }
+}
+
+/*
+ * Frees everything still waiting. No reader may be inside a guard.
+ */
+inline EpochReclaimer::~EpochReclaimer()
+{
+    for (int i = 0; i < 3; ++i) freeList(retired_[i]);
+}
+
+/*
+ * Joins the slot this thread already holds here, if it still holds one.
+ * Otherwise claims a free slot and announces the current epoch in it,
+ * starting from the thread's usual slot, or failing that joins whichever
+ * slot is in use. Never waits for another reader to leave.
+ */
+inline size_t EpochReclaimer::enter()
+{
+    static thread_local Hint hints[hintCount] = {};
+    static thread_local size_t nextHint = 0;
+    Hint* mine = NULL;
+    for (size_t i = 0; i < hintCount && mine == NULL; ++i)
+    {
+      if (hints[i].reclaimer_ == this) mine = &hints[i];
+    }
+    if (mine == NULL)
+    {
+      mine = &hints[nextHint];
+      nextHint = (nextHint + 1) % hintCount;
+      mine->reclaimer_ = this;
+      mine->slot_ = std::hash<std::thread::id>()(std::this_thread::get_id()) % maxReaders;
+    }
+    else if (join(mine->slot_))
+    {
+      return mine->slot_;
+    }
+
+    while (true)
+    {
+      for (size_t i = 0; i < maxReaders; ++i)
+      {
+        size_t index = (mine->slot_ + i) % maxReaders;
+        Slot& slot = slots_[index];
+        uint64_t epoch = epoch_.load();
+        uint64_t free = 0;
+        if (slot.epoch_.load(std::memory_order_relaxed) == 0 &&
+            slot.epoch_.compare_exchange_strong(free, epoch))
+        {
+          slot.holders_.store(1);
+          mine->slot_ = index;
+          return index;
+        }
+      }
+      for (size_t i = 0; i < maxReaders; ++i)
+      {
+        size_t index = (mine->slot_ + i) % maxReaders;
+        if (join(index)) return index;
+      }
+    }
+}
+
+/*
+ * Adds a holder to a slot that is in use, and fails on one that is free
+ * or being freed.
+ */
+inline bool EpochReclaimer::join(size_t slot)
+{
+    std::atomic<size_t>& holders = slots_[slot].holders_;
+    size_t seen = holders.load();
+    while (seen != 0)
+    {
+      if (holders.compare_exchange_weak(seen, seen + 1)) return true;
+    }
+    return false;
+}
+
+inline void EpochReclaimer::leave(size_t slot)
+{
+    if (slots_[slot].holders_.fetch_sub(1) == 1) slots_[slot].epoch_.store(0, std::memory_order_release);
+}
+
+template <class T>
+void EpochReclaimer::retire(T* object)
+{
+    retire(object, &EpochReclaimer::deleteObject<T>);
+}
+
+/*
+ * Queues object to be passed to deleter once no reader can reach it. Every
+ * few dozen calls also tries to move the epoch on and free what is safe.
+ */
+inline void EpochReclaimer::retire(void* object, void (*deleter)(void*))
+{
+    std::lock_guard<std::mutex> guard(retireLock_);
+    Retired r = { object, deleter };
+    retired_[epoch_.load() % 3].push_back(r);
+    if (++sinceCollect_ >= 64)
+    {
+      sinceCollect_ = 0;
+      tryAdvance();
+    }
+}
+
+/*
+ * Frees whatever the readers currently inside guards allow. Calling it
+ * three times with no readers about frees everything.
+ */
+inline void EpochReclaimer::collect()
+{
+    std::lock_guard<std::mutex> guard(retireLock_);
+    tryAdvance();
+}
+
+/*
+ * How many retired objects are still waiting to be freed.
+ */
+inline size_t EpochReclaimer::pending() const
+{
+    std::lock_guard<std::mutex> guard(retireLock_);
+    return retired_[0].size() + retired_[1].size() + retired_[2].size();
+}
+
+/*
+ * Moves the epoch from e to e + 1 if every reader has announced e, and frees
+ * the list retired during e - 2. Callers hold retireLock_.
+ */
+inline bool EpochReclaimer::tryAdvance()
+{
+    uint64_t epoch = epoch_.load();
+    for (size_t i = 0; i < maxReaders; ++i)
+    {
+      uint64_t seen = slots_[i].epoch_.load();
+      if (seen != 0 && seen != epoch) return false;
+    }
+    epoch_.store(epoch + 1);
+    freeList(retired_[(epoch + 1) % 3]);
+    return true;
+}
+
+inline void EpochReclaimer::freeList(std::vector<Retired>& list)
+{
+    for (size_t i = 0; i < list.size(); ++i) list[i].deleter_(list[i].object_);
+    list.clear();
+}
+
+
+#endif
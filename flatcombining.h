@@ -0,0 +1,228 @@
+#ifndef FLATCOMBINING_H
+#define FLATCOMBINING_H
+
+#include <iostream>
+#include <exception>
+#include <cstdlib>
+#include <cstdint>
+#include <new>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <functional>
+#include "avlbst.h"
+
+/**
+* An AVLTree shared between threads by flat combining (Hendler, Incze,
+* Shavit and Tzafrir). Rather than queueing on a lock, a thread posts its
+* operation in a publication slot and tries to become the combiner; the one
+* that gets the lock picks up every posted operation, sorts them by key,
+* applies them in one sweep while the tree is warm in its cache, and marks
+* each done. The others spin on their own slot until their answer is in.
+* Under heavy contention the lock changes hands once per batch instead of
+* once per operation.
+*
+* Slots sit on their own cache lines. A thread takes a free slot for the
+* length of one call, starting with the one it used last, so at most
+* maxThreads calls can be in flight; more wait for a slot.
+*/
+template <class Key, class Value>
+class CombiningAVLTree
+{
+public:
+    static const size_t maxThreads = 64;
+    static const size_t cacheLine = 64;
+
+    CombiningAVLTree();
+
+    void insert(const std::pair<const Key, Value>& keyValuePair);
+    void remove(const Key& key);
+    bool find(const Key& key, Value& value);
+    size_t size();
+    bool empty();
+
+protected:
+    enum SlotState {slotFree, slotClaimed, slotPending, slotDone};
+    enum Operation {opInsert, opRemove, opFind};
+
+    /*
+     * One posted operation. The key and values point into the caller's
+     * frame, which waits until the combiner is done with them.
+     */
+    struct Slot
+    {
+      std::atomic<int> state_;
+      Operation op_;
+      const Key* key_;
+      const Value* value_;
+      Value* result_;
+      bool found_;
+      char pad_[cacheLine - sizeof(std::atomic<int>) - sizeof(Operation) - 3 * sizeof(void*) - sizeof(bool)];
+    };
+
+    // orders posted slots by key
+    struct SlotOrder
+    {
+      bool operator()(const Slot* lhs, const Slot* rhs) const { return *lhs->key_ < *rhs->key_; }
+    };
+
+    bool post(Operation op, const Key& key, const Value* value, Value* result);
+    void combine();
+
+    CombiningAVLTree(const CombiningAVLTree<Key, Value>&);
+    CombiningAVLTree<Key, Value>& operator=(const CombiningAVLTree<Key, Value>&);
+
+    // slots_ starts at the first line boundary in slotStorage_, since the
+    // tree itself may sit anywhere (new only promises 16 bytes)
+    char slotStorage_[(maxThreads + 1) * cacheLine];
+    Slot* slots_;
+    std::mutex combineLock_;
+    AVLTree<Key, Value> tree_;
+    // the combiner's scratch list, kept to save reallocating it per batch
+    std::vector<Slot*> batch_;
+};
+
+
+template<class Key, class Value>
+CombiningAVLTree<Key, Value>::CombiningAVLTree()
+{
+    static_assert(sizeof(Slot) == cacheLine, "a publication slot must fill one cache line");
+    uintptr_t storage = reinterpret_cast<uintptr_t>(slotStorage_);
+    slots_ = reinterpret_cast<Slot*>((storage + cacheLine - 1) & ~(uintptr_t)(cacheLine - 1));
+    for (size_t i = 0; i < maxThreads; ++i)
+    {
+      new (&slots_[i]) Slot();
+      slots_[i].state_.store(slotFree, std::memory_order_relaxed);
+    }
+    batch_.reserve(maxThreads);
+}
+
+/*
+ * Recall: If key is already in the tree, you should
+ * overwrite the current value with the updated value.
+ */
+template<class Key, class Value>
+void CombiningAVLTree<Key, Value>::insert(const std::pair<const Key, Value>& keyValuePair)
+{
+    post(opInsert, keyValuePair.first, &keyValuePair.second, NULL);
+}
+
+template<class Key, class Value>
+void CombiningAVLTree<Key, Value>::remove(const Key& key)
+{
+    post(opRemove, key, NULL, NULL);
+}
+
+/*
+ * Copies the value for key into value and returns true, or returns false
+ * if the key is absent.
+ */
+template<class Key, class Value>
+bool CombiningAVLTree<Key, Value>::find(const Key& key, Value& value)
+{
+    return post(opFind, key, NULL, &value);
+}
+
+template<class Key, class Value>
+size_t CombiningAVLTree<Key, Value>::size()
+{
+    std::lock_guard<std::mutex> guard(combineLock_);
+    return tree_.size();
+}
+
+template<class Key, class Value>
+bool CombiningAVLTree<Key, Value>::empty()
+{
+    return size() == 0;
+}
+
+/*
+ * Publishes one operation and waits for it, combining whenever the lock is
+ * free. Returns whether a find found its key.
+ */
+template<class Key, class Value>
+bool CombiningAVLTree<Key, Value>::post(Operation op, const Key& key, const Value* value, Value* result)
+{
+    static thread_local size_t hint = std::hash<std::thread::id>()(std::this_thread::get_id()) % maxThreads;
+    Slot* slot = NULL;
+    for (size_t tries = 1; slot == NULL; ++tries)
+    {
+      int expected = slotFree;
+      if (slots_[hint].state_.load(std::memory_order_relaxed) == slotFree &&
+          slots_[hint].state_.compare_exchange_strong(expected, slotClaimed))
+      {
+        slot = &slots_[hint];
+      }
+      else
+      {
+        hint = (hint + 1) % maxThreads;
+        if (tries % maxThreads == 0) std::this_thread::yield();
+      }
+    }
+
+    slot->op_ = op;
+    slot->key_ = &key;
+    slot->value_ = value;
+    slot->result_ = result;
+    slot->state_.store(slotPending, std::memory_order_release);
+
+    for (unsigned spins = 1; slot->state_.load(std::memory_order_acquire) != slotDone; ++spins)
+    {
+      if (combineLock_.try_lock())
+      {
+        std::lock_guard<std::mutex> guard(combineLock_, std::adopt_lock);
+        combine();
+      }
+      else if (spins % 64 == 0)
+      {
+        std::this_thread::yield();
+      }
+    }
+    bool found = slot->found_;
+    slot->state_.store(slotFree, std::memory_order_release);
+    return found;
+}
+
+/*
+ * Applies every posted operation in key order. Callers hold combineLock_.
+ */
+template<class Key, class Value>
+void CombiningAVLTree<Key, Value>::combine()
+{
+    batch_.clear();
+    for (size_t i = 0; i < maxThreads; ++i)
+    {
+      if (slots_[i].state_.load(std::memory_order_acquire) == slotPending) batch_.push_back(&slots_[i]);
+    }
+    std::sort(batch_.begin(), batch_.end(), SlotOrder());
+
+    for (size_t i = 0; i < batch_.size(); ++i)
+    {
+      Slot* slot = batch_[i];
+      slot->found_ = false;
+      if (slot->op_ == opInsert)
+      {
+        tree_.insert(std::make_pair(*slot->key_, *slot->value_));
+      }
+      else if (slot->op_ == opRemove)
+      {
+        tree_.remove(*slot->key_);
+      }
+      else
+      {
+        typename AVLTree<Key, Value>::iterator it = tree_.find(*slot->key_);
+        if (it != tree_.end())
+        {
+          *slot->result_ = it->second;
+          slot->found_ = true;
+        }
+      }
+      slot->state_.store(slotDone, std::memory_order_release);
+    }
+}
+
+
+#endif
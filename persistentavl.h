@@ -0,0 +1,443 @@
+#ifndef PERSISTENTAVL_H
+#define PERSISTENTAVL_H
+
+#include <iostream>
+#include <exception>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <stdexcept>
+
+/*
+ * An immutable node. Once built it is never changed, so any number of
+ * trees and snapshots can share it; it lives as long as one of them does.
+ * count_ is the number of items in the subtree.
+ */
+template <class Key, class Value>
+struct PersistentAVLNode
+{
+    typedef std::shared_ptr<const PersistentAVLNode<Key, Value> > Ptr;
+
+    PersistentAVLNode(const std::pair<const Key, Value>& item, const Ptr& left, const Ptr& right) :
+        item_(item), left_(left), right_(right),
+        height_(1 + std::max(left ? left->height_ : 0, right ? right->height_ : 0)),
+        count_(1 + (left ? left->count_ : 0) + (right ? right->count_ : 0)) { }
+
+    std::pair<const Key, Value> item_;
+    Ptr left_;
+    Ptr right_;
+    int height_;
+    size_t count_;
+};
+
+/**
+* A frozen view of a PersistentAVLTree. Taking one is O(1) and it never
+* changes, whatever the tree does afterwards, so it can be read at leisure
+* on any thread without locks. It shares every node with the tree except
+* those on paths the tree has copied since.
+*/
+template <class Key, class Value>
+class AVLSnapshot
+{
+public:
+    typedef PersistentAVLNode<Key, Value> Node;
+
+    /**
+    * Walks the snapshot in key order, keeping the path to the current item.
+    */
+    class iterator
+    {
+    public:
+        iterator();
+
+        const std::pair<const Key, Value>& operator*() const;
+        const std::pair<const Key, Value>* operator->() const;
+
+        bool operator==(const iterator& rhs) const;
+        bool operator!=(const iterator& rhs) const;
+
+        iterator& operator++();
+
+    protected:
+        friend class AVLSnapshot<Key, Value>;
+        // the ancestors still to visit, current item on top
+        std::vector<const Node*> path_;
+    };
+
+    AVLSnapshot();
+    AVLSnapshot(const typename Node::Ptr& root);
+
+    iterator begin() const;
+    iterator end() const;
+    iterator find(const Key& key) const;
+    const Value& operator[](const Key& key) const;
+    size_t size() const;
+    bool empty() const;
+    int height() const;
+
+protected:
+    typename Node::Ptr root_;
+};
+
+/**
+* An AVL tree whose updates copy the O(log n) nodes on the root path instead
+* of changing nodes in place, so every version of the tree stays intact for
+* as long as something refers to it. snapshot() hands out the current
+* version in O(1), and a snapshot costs only the nodes written since it was
+* taken. Long scans over a snapshot never hold up writers, and writers never
+* disturb a scan.
+*
+* Writers take a mutex between them. The root is read and published with
+* the shared_ptr atomic functions, so snapshots can be taken from any
+* thread at any time.
+*/
+template <class Key, class Value>
+class PersistentAVLTree
+{
+public:
+    typedef PersistentAVLNode<Key, Value> Node;
+    typedef typename Node::Ptr NodePtr;
+
+    PersistentAVLTree();
+
+    void insert(const std::pair<const Key, Value>& keyValuePair);
+    void remove(const Key& key);
+    void clear();
+    bool find(const Key& key, Value& value) const;
+    size_t size() const;
+    bool empty() const;
+
+    AVLSnapshot<Key, Value> snapshot() const;
+
+protected:
+    static NodePtr make(const std::pair<const Key, Value>& item, const NodePtr& left, const NodePtr& right);
+    static NodePtr balance(const std::pair<const Key, Value>& item, const NodePtr& left, const NodePtr& right);
+    static NodePtr insertInto(const NodePtr& node, const std::pair<const Key, Value>& item);
+    static NodePtr removeFrom(const NodePtr& node, const Key& key);
+    static NodePtr removeSmallest(const NodePtr& node, const Node*& smallest);
+    static int height(const NodePtr& node);
+
+    PersistentAVLTree(const PersistentAVLTree<Key, Value>&);
+    PersistentAVLTree<Key, Value>& operator=(const PersistentAVLTree<Key, Value>&);
+
+    NodePtr root_;
+    std::mutex writeLock_;
+};
+
+/*
+  -------------------------------------------------
+  Begin implementations for the AVLSnapshot class.
+  -------------------------------------------------
+*/
+
+template<class Key, class Value>
+AVLSnapshot<Key, Value>::iterator::iterator()
+{
+
+}
+
+template<class Key, class Value>
+const std::pair<const Key, Value>& AVLSnapshot<Key, Value>::iterator::operator*() const
+{
+    return path_.back()->item_;
+}
+
+template<class Key, class Value>
+const std::pair<const Key, Value>* AVLSnapshot<Key, Value>::iterator::operator->() const
+{
+    return &(path_.back()->item_);
+}
+
+template<class Key, class Value>
+bool AVLSnapshot<Key, Value>::iterator::operator==(const iterator& rhs) const
+{
+    if (path_.empty() || rhs.path_.empty()) return path_.empty() == rhs.path_.empty();
+    return path_.back() == rhs.path_.back();
+}
+
+template<class Key, class Value>
+bool AVLSnapshot<Key, Value>::iterator::operator!=(const iterator& rhs) const
+{
+    return !(*this == rhs);
+}
+
+/*
+ * Pops the current item and pushes the left spine of its right subtree.
+ */
+template<class Key, class Value>
+typename AVLSnapshot<Key, Value>::iterator& AVLSnapshot<Key, Value>::iterator::operator++()
+{
+    const Node* curr = path_.back()->right_.get();
+    path_.pop_back();
+    for (; curr != NULL; curr = curr->left_.get()) path_.push_back(curr);
+    return *this;
+}
+
+template<class Key, class Value>
+AVLSnapshot<Key, Value>::AVLSnapshot()
+{
+
+}
+
+template<class Key, class Value>
+AVLSnapshot<Key, Value>::AVLSnapshot(const typename Node::Ptr& root) : root_(root)
+{
+
+}
+
+template<class Key, class Value>
+typename AVLSnapshot<Key, Value>::iterator AVLSnapshot<Key, Value>::begin() const
+{
+    iterator it;
+    for (const Node* curr = root_.get(); curr != NULL; curr = curr->left_.get()) it.path_.push_back(curr);
+    return it;
+}
+
+template<class Key, class Value>
+typename AVLSnapshot<Key, Value>::iterator AVLSnapshot<Key, Value>::end() const
+{
+    return iterator();
+}
+
+/*
+ * Returns an iterator to the key, or end() if absent. The path kept is the
+ * nodes the search turned left at, which are the ones still to visit.
+ */
+template<class Key, class Value>
+typename AVLSnapshot<Key, Value>::iterator AVLSnapshot<Key, Value>::find(const Key& key) const
+{
+    iterator it;
+    const Node* curr = root_.get();
+    while (curr != NULL)
+    {
+      if (key < curr->item_.first)
+      {
+        it.path_.push_back(curr);
+        curr = curr->left_.get();
+      }
+      else if (curr->item_.first < key)
+      {
+        curr = curr->right_.get();
+      }
+      else
+      {
+        it.path_.push_back(curr);
+        return it;
+      }
+    }
+    return end();
+}
+
+/**
+ * @precondition The key exists in the map
+ * Returns the value associated with the key
+ */
+template<class Key, class Value>
+const Value& AVLSnapshot<Key, Value>::operator[](const Key& key) const
+{
+    iterator it = find(key);
+    if (it == end()) throw std::out_of_range("Invalid key");
+    return it->second;
+}
+
+template<class Key, class Value>
+size_t AVLSnapshot<Key, Value>::size() const
+{
+    return root_ ? root_->count_ : 0;
+}
+
+template<class Key, class Value>
+bool AVLSnapshot<Key, Value>::empty() const
+{
+    return !root_;
+}
+
+template<class Key, class Value>
+int AVLSnapshot<Key, Value>::height() const
+{
+    return root_ ? root_->height_ : 0;
+}
+
+/*
+  -------------------------------------------------------
+  Begin implementations for the PersistentAVLTree class.
+  -------------------------------------------------------
+*/
+
+template<class Key, class Value>
+PersistentAVLTree<Key, Value>::PersistentAVLTree()
+{
+
+}
+
+/*
+ * Recall: If key is already in the tree, you should
+ * overwrite the current value with the updated value.
+ */
+template<class Key, class Value>
+void PersistentAVLTree<Key, Value>::insert(const std::pair<const Key, Value>& keyValuePair)
+{
+    std::lock_guard<std::mutex> guard(writeLock_);
+    std::atomic_store(&root_, insertInto(root_, keyValuePair));
+}
+
+template<class Key, class Value>
+void PersistentAVLTree<Key, Value>::remove(const Key& key)
+{
+    std::lock_guard<std::mutex> guard(writeLock_);
+    NodePtr root = removeFrom(root_, key);
+    if (root != root_) std::atomic_store(&root_, root);
+}
+
+/*
+ * Empties the tree. Snapshots keep their items.
+ */
+template<class Key, class Value>
+void PersistentAVLTree<Key, Value>::clear()
+{
+    std::lock_guard<std::mutex> guard(writeLock_);
+    std::atomic_store(&root_, NodePtr());
+}
+
+/*
+ * Copies the value for key into value and returns true, or returns false
+ * if the key is absent.
+ */
+template<class Key, class Value>
+bool PersistentAVLTree<Key, Value>::find(const Key& key, Value& value) const
+{
+    AVLSnapshot<Key, Value> view = snapshot();
+    typename AVLSnapshot<Key, Value>::iterator it = view.find(key);
+    if (it == view.end()) return false;
+    value = it->second;
+    return true;
+}
+
+template<class Key, class Value>
+size_t PersistentAVLTree<Key, Value>::size() const
+{
+    return snapshot().size();
+}
+
+template<class Key, class Value>
+bool PersistentAVLTree<Key, Value>::empty() const
+{
+    return snapshot().empty();
+}
+
+/*
+ * The tree as it stands, in O(1).
+ */
+template<class Key, class Value>
+AVLSnapshot<Key, Value> PersistentAVLTree<Key, Value>::snapshot() const
+{
+    return AVLSnapshot<Key, Value>(std::atomic_load(&root_));
+}
+
+template<class Key, class Value>
+typename PersistentAVLTree<Key, Value>::NodePtr
+PersistentAVLTree<Key, Value>::make(const std::pair<const Key, Value>& item, const NodePtr& left, const NodePtr& right)
+{
+    return std::make_shared<const Node>(item, left, right);
+}
+
+/*
+ * Builds a node over left and right, whose heights differ by at most two,
+ * rotating with fresh nodes where they differ by two. The subtrees below
+ * the rotated nodes are shared, not copied.
+ */
+template<class Key, class Value>
+typename PersistentAVLTree<Key, Value>::NodePtr
+PersistentAVLTree<Key, Value>::balance(const std::pair<const Key, Value>& item, const NodePtr& left, const NodePtr& right)
+{
+    int hl = height(left);
+    int hr = height(right);
+    if (hl > hr + 1)
+    {
+      if (height(left->left_) >= height(left->right_))
+      {
+        return make(left->item_, left->left_, make(item, left->right_, right));
+      }
+      const NodePtr& inner = left->right_;
+      return make(inner->item_, make(left->item_, left->left_, inner->left_), make(item, inner->right_, right));
+    }
+    if (hr > hl + 1)
+    {
+      if (height(right->right_) >= height(right->left_))
+      {
+        return make(right->item_, make(item, left, right->left_), right->right_);
+      }
+      const NodePtr& inner = right->left_;
+      return make(inner->item_, make(item, left, inner->left_), make(right->item_, inner->right_, right->right_));
+    }
+    return make(item, left, right);
+}
+
+template<class Key, class Value>
+typename PersistentAVLTree<Key, Value>::NodePtr
+PersistentAVLTree<Key, Value>::insertInto(const NodePtr& node, const std::pair<const Key, Value>& item)
+{
+    if (!node) return make(item, NodePtr(), NodePtr());
+    if (item.first < node->item_.first)
+    {
+      return balance(node->item_, insertInto(node->left_, item), node->right_);
+    }
+    if (node->item_.first < item.first)
+    {
+      return balance(node->item_, node->left_, insertInto(node->right_, item));
+    }
+    return make(item, node->left_, node->right_);
+}
+
+/*
+ * Returns node itself when key is absent, so nothing is copied.
+ */
+template<class Key, class Value>
+typename PersistentAVLTree<Key, Value>::NodePtr
+PersistentAVLTree<Key, Value>::removeFrom(const NodePtr& node, const Key& key)
+{
+    if (!node) return node;
+    if (key < node->item_.first)
+    {
+      NodePtr left = removeFrom(node->left_, key);
+      return left == node->left_ ? node : balance(node->item_, left, node->right_);
+    }
+    if (node->item_.first < key)
+    {
+      NodePtr right = removeFrom(node->right_, key);
+      return right == node->right_ ? node : balance(node->item_, node->left_, right);
+    }
+    if (!node->left_) return node->right_;
+    if (!node->right_) return node->left_;
+    const Node* smallest = NULL;
+    NodePtr right = removeSmallest(node->right_, smallest);
+    return balance(smallest->item_, node->left_, right);
+}
+
+/*
+ * Returns node without its smallest item, which is pointed to by smallest.
+ * That node stays alive as long as node does.
+ */
+template<class Key, class Value>
+typename PersistentAVLTree<Key, Value>::NodePtr
+PersistentAVLTree<Key, Value>::removeSmallest(const NodePtr& node, const Node*& smallest)
+{
+    if (!node->left_)
+    {
+      smallest = node.get();
+      return node->right_;
+    }
+    return balance(node->item_, removeSmallest(node->left_, smallest), node->right_);
+}
+
+template<class Key, class Value>
+int PersistentAVLTree<Key, Value>::height(const NodePtr& node)
+{
+    return node ? node->height_ : 0;
+}
+
+
+#endif
@@ -0,0 +1,946 @@
+#ifndef RADIXTREE_H
+#define RADIXTREE_H
+
+#include <iostream>
+#include <exception>
+#include <cstdlib>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <utility>
+#include <type_traits>
+#include <stdexcept>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/**
+* Turns a key into a byte string whose byte-wise order is the key's order
+* and where no key's bytes are a prefix of another's. The radix tree only
+* ever looks at these bytes.
+*/
+template <class Key, class Enable = void>
+struct RadixKey;
+
+/*
+ * Integers become their big-endian bytes, with the sign bit flipped for
+ * signed types so negatives sort first. Every key has the same length.
+ */
+template <class Key>
+struct RadixKey<Key, typename std::enable_if<std::is_integral<Key>::value>::type>
+{
+    static void encode(const Key& key, std::string& out)
+    {
+      typedef typename std::make_unsigned<Key>::type Bits;
+      Bits bits = static_cast<Bits>(key);
+      if (std::is_signed<Key>::value) bits ^= Bits(1) << (sizeof(Key) * 8 - 1);
+      out.resize(sizeof(Key));
+      for (size_t i = 0; i < sizeof(Key); ++i)
+      {
+        out[i] = static_cast<char>(bits >> ((sizeof(Key) - 1 - i) * 8));
+      }
+    }
+};
+
+/*
+ * Strings keep their bytes, except that a zero byte becomes 00 01 and the
+ * end of the string becomes 00 00. That keeps the order and stops "ab"
+ * from being a prefix of "abc".
+ */
+template <>
+struct RadixKey<std::string>
+{
+    static void encode(const std::string& key, std::string& out)
+    {
+      out.clear();
+      out.reserve(key.size() + 2);
+      for (size_t i = 0; i < key.size(); ++i)
+      {
+        out.push_back(key[i]);
+        if (key[i] == '\0') out.push_back('\1');
+      }
+      out.push_back('\0');
+      out.push_back('\0');
+    }
+};
+
+enum RadixNodeType {radixLeaf, radixNode4, radixNode16, radixNode48, radixNode256};
+
+template <class Key, class Value>
+struct RadixNode
+{
+    RadixNode(uint8_t type) : type_(type) { }
+    uint8_t type_;
+};
+
+/*
+ * Leaves hold the item and its encoded key, and are chained in key order
+ * so the iterator can step without climbing the tree.
+ */
+template <class Key, class Value>
+struct RadixLeaf : public RadixNode<Key, Value>
+{
+    RadixLeaf(const std::pair<const Key, Value>& item, const std::string& key) :
+        RadixNode<Key, Value>(radixLeaf), item_(item), key_(key), prev_(NULL), next_(NULL) { }
+    std::pair<const Key, Value> item_;
+    std::string key_;
+    RadixLeaf<Key, Value>* prev_;
+    RadixLeaf<Key, Value>* next_;
+};
+
+/*
+ * An inner node. prefix_ holds the bytes every key below shares after the
+ * byte that led here, so chains of single-child nodes never exist.
+ */
+template <class Key, class Value>
+struct RadixInner : public RadixNode<Key, Value>
+{
+    RadixInner(uint8_t type) : RadixNode<Key, Value>(type), count_(0) { }
+    uint16_t count_;
+    std::string prefix_;
+};
+
+// up to 4 children, keys sorted
+template <class Key, class Value>
+struct RadixNode4 : public RadixInner<Key, Value>
+{
+    RadixNode4() : RadixInner<Key, Value>(radixNode4) { }
+    uint8_t keys_[4];
+    RadixNode<Key, Value>* children_[4];
+};
+
+// up to 16 children, keys sorted
+template <class Key, class Value>
+struct RadixNode16 : public RadixInner<Key, Value>
+{
+    RadixNode16() : RadixInner<Key, Value>(radixNode16) { }
+    uint8_t keys_[16];
+    RadixNode<Key, Value>* children_[16];
+};
+
+// up to 48 children; index_ maps a byte to its slot plus one, 0 if absent
+template <class Key, class Value>
+struct RadixNode48 : public RadixInner<Key, Value>
+{
+    RadixNode48() : RadixInner<Key, Value>(radixNode48)
+    {
+      std::memset(index_, 0, sizeof(index_));
+      std::memset(children_, 0, sizeof(children_));
+    }
+    uint8_t index_[256];
+    RadixNode<Key, Value>* children_[48];
+};
+
+// one slot per byte
+template <class Key, class Value>
+struct RadixNode256 : public RadixInner<Key, Value>
+{
+    RadixNode256() : RadixInner<Key, Value>(radixNode256)
+    {
+      std::memset(children_, 0, sizeof(children_));
+    }
+    RadixNode<Key, Value>* children_[256];
+};
+
+/**
+* An adaptive radix tree (Leis et al., ICDE 2013). Keys are looked up a byte
+* at a time, so a lookup costs the key's length rather than log n full key
+* comparisons. Inner nodes grow from 4 to 16 to 48 to 256 children as they
+* fill, and shrink back as they empty, and runs of shared bytes are
+* compressed into a node's prefix.
+*
+* It offers the same ordered insert/remove/find/begin/end interface as
+* BinarySearchTree for any key with a RadixKey specialization (integers and
+* std::string come with one).
+*/
+template <class Key, class Value>
+class AdaptiveRadixTree
+{
+public:
+    AdaptiveRadixTree();
+    AdaptiveRadixTree(const AdaptiveRadixTree<Key, Value>& other);
+    AdaptiveRadixTree(AdaptiveRadixTree<Key, Value>&& other);
+    ~AdaptiveRadixTree();
+    AdaptiveRadixTree<Key, Value>& operator=(const AdaptiveRadixTree<Key, Value>& other);
+    AdaptiveRadixTree<Key, Value>& operator=(AdaptiveRadixTree<Key, Value>&& other);
+
+    void insert(const std::pair<const Key, Value>& keyValuePair);
+    void remove(const Key& key);
+    void erase(const Key& lo, const Key& hi);
+    void clear();
+    bool empty() const;
+    size_t size() const;
+
+    class iterator
+    {
+    public:
+        iterator();
+
+        std::pair<const Key,Value>& operator*() const;
+        std::pair<const Key,Value>* operator->() const;
+
+        bool operator==(const iterator& rhs) const;
+        bool operator!=(const iterator& rhs) const;
+
+        iterator& operator++();
+
+    protected:
+        friend class AdaptiveRadixTree<Key, Value>;
+        iterator(RadixLeaf<Key, Value>* ptr);
+        RadixLeaf<Key, Value>* current_;
+    };
+
+    iterator begin() const;
+    iterator end() const;
+    iterator find(const Key& key) const;
+    Value& operator[](const Key& key);
+    Value const & operator[](const Key& key) const;
+
+protected:
+    typedef RadixNode<Key, Value> NodeT;
+    typedef RadixLeaf<Key, Value> LeafT;
+    typedef RadixInner<Key, Value> InnerT;
+
+    LeafT* findLeaf(const std::string& key) const;
+    static LeafT* bound(NodeT* n, const std::string& key, size_t depth, bool strict);
+    static LeafT* minLeaf(NodeT* n);
+    static NodeT** findChild(InnerT* n, uint8_t byte);
+    static NodeT* childAfter(InnerT* n, int byte);
+    static void addChild(NodeT** ref, InnerT* n, uint8_t byte, NodeT* child);
+    static void removeChild(NodeT** ref, InnerT* n, uint8_t byte);
+    static void freeNode(NodeT* n);
+
+    NodeT* root_;
+    LeafT* head_;
+    LeafT* tail_;
+    size_t size_;
+};
+
+template<class Key, class Value>
+AdaptiveRadixTree<Key, Value>::iterator::iterator(RadixLeaf<Key,Value> *ptr) : current_(ptr)
+{
+
+}
+
+template<class Key, class Value>
+AdaptiveRadixTree<Key, Value>::iterator::iterator() : current_(NULL)
+{
+
+}
+
+template<class Key, class Value>
+std::pair<const Key,Value> & AdaptiveRadixTree<Key, Value>::iterator::operator*() const
+{
+    return current_->item_;
+}
+
+template<class Key, class Value>
+std::pair<const Key,Value> * AdaptiveRadixTree<Key, Value>::iterator::operator->() const
+{
+    return &(current_->item_);
+}
+
+template<class Key, class Value>
+bool AdaptiveRadixTree<Key, Value>::iterator::operator==(const iterator& rhs) const
+{
+    return current_ == rhs.current_;
+}
+
+template<class Key, class Value>
+bool AdaptiveRadixTree<Key, Value>::iterator::operator!=(const iterator& rhs) const
+{
+    return current_ != rhs.current_;
+}
+
+template<class Key, class Value>
+typename AdaptiveRadixTree<Key, Value>::iterator& AdaptiveRadixTree<Key, Value>::iterator::operator++()
+{
+    current_ = current_->next_;
+    return *this;
+}
+
+
+template<class Key, class Value>
+AdaptiveRadixTree<Key, Value>::AdaptiveRadixTree() : root_(NULL), head_(NULL), tail_(NULL), size_(0)
+{
+
+}
+
+template<class Key, class Value>
+AdaptiveRadixTree<Key, Value>::AdaptiveRadixTree(const AdaptiveRadixTree<Key, Value>& other) :
+    root_(NULL), head_(NULL), tail_(NULL), size_(0)
+{
+    for (iterator it = other.begin(); it != other.end(); ++it) insert(*it);
+}
+
+template<class Key, class Value>
+AdaptiveRadixTree<Key, Value>::AdaptiveRadixTree(AdaptiveRadixTree<Key, Value>&& other) :
+    root_(other.root_), head_(other.head_), tail_(other.tail_), size_(other.size_)
+{
+    other.root_ = NULL;
+    other.head_ = NULL;
+    other.tail_ = NULL;
+    other.size_ = 0;
+}
+
+template<class Key, class Value>
+AdaptiveRadixTree<Key, Value>::~AdaptiveRadixTree()
+{
+    clear();
+}
+
+template<class Key, class Value>
+AdaptiveRadixTree<Key, Value>& AdaptiveRadixTree<Key, Value>::operator=(const AdaptiveRadixTree<Key, Value>& other)
+{
+    if (this != &other)
+    {
+      clear();
+      for (iterator it = other.begin(); it != other.end(); ++it) insert(*it);
+    }
+    return *this;
+}
+
+template<class Key, class Value>
+AdaptiveRadixTree<Key, Value>& AdaptiveRadixTree<Key, Value>::operator=(AdaptiveRadixTree<Key, Value>&& other)
+{
+    if (this != &other)
+    {
+      clear();
+      root_ = other.root_;
+      head_ = other.head_;
+      tail_ = other.tail_;
+      size_ = other.size_;
+      other.root_ = NULL;
+      other.head_ = NULL;
+      other.tail_ = NULL;
+      other.size_ = 0;
+    }
+    return *this;
+}
+
+template<class Key, class Value>
+typename AdaptiveRadixTree<Key, Value>::iterator AdaptiveRadixTree<Key, Value>::begin() const
+{
+    return iterator(head_);
+}
+
+template<class Key, class Value>
+typename AdaptiveRadixTree<Key, Value>::iterator AdaptiveRadixTree<Key, Value>::end() const
+{
+    return iterator(NULL);
+}
+
+template<class Key, class Value>
+typename AdaptiveRadixTree<Key, Value>::iterator AdaptiveRadixTree<Key, Value>::find(const Key& key) const
+{
+    std::string bytes;
+    RadixKey<Key>::encode(key, bytes);
+    return iterator(findLeaf(bytes));
+}
+
+/**
+ * @precondition The key exists in the map
+ * Returns the value associated with the key
+ */
+template<class Key, class Value>
+Value& AdaptiveRadixTree<Key, Value>::operator[](const Key& key)
+{
+    iterator it = find(key);
+    if (it == end()) throw std::out_of_range("Invalid key");
+    return it->second;
+}
+
+template<class Key, class Value>
+Value const & AdaptiveRadixTree<Key, Value>::operator[](const Key& key) const
+{
+    iterator it = find(key);
+    if (it == end()) throw std::out_of_range("Invalid key");
+    return it->second;
+}
+
+template<class Key, class Value>
+bool AdaptiveRadixTree<Key, Value>::empty() const
+{
+    return root_ == NULL;
+}
+
+template<class Key, class Value>
+size_t AdaptiveRadixTree<Key, Value>::size() const
+{
+    return size_;
+}
+
+/*
+ * Recall: If key is already in the tree, you should
+ * overwrite the current value with the updated value.
+ * The new leaf goes where the descent runs out: into an empty slot of an
+ * inner node, or under a new Node4 where it parts ways with an existing
+ * leaf or with an inner node's prefix.
+ */
+template<class Key, class Value>
+void AdaptiveRadixTree<Key, Value>::insert(const std::pair<const Key, Value>& keyValuePair)
+{
+    std::string key;
+    RadixKey<Key>::encode(keyValuePair.first, key);
+
+    NodeT** ref = &root_;
+    size_t depth = 0;
+    LeafT* leaf = NULL;
+    while (leaf == NULL)
+    {
+      NodeT* n = *ref;
+      if (n == NULL)
+      {
+        leaf = new LeafT(keyValuePair, key);
+        *ref = leaf;
+      }
+      else if (n->type_ == radixLeaf)
+      {
+        LeafT* existing = static_cast<LeafT*>(n);
+        if (existing->key_ == key)
+        {
+          existing->item_.second = keyValuePair.second;
+          return;
+        }
+        // split where the two keys part ways
+        size_t common = depth;
+        while (existing->key_[common] == key[common]) common++;
+        leaf = new LeafT(keyValuePair, key);
+        RadixNode4<Key, Value>* split = new RadixNode4<Key, Value>();
+        split->prefix_ = key.substr(depth, common - depth);
+        addChild(ref, split, (uint8_t)existing->key_[common], existing);
+        addChild(ref, split, (uint8_t)key[common], leaf);
+        *ref = split;
+      }
+      else
+      {
+        InnerT* inner = static_cast<InnerT*>(n);
+        size_t matched = 0;
+        while (matched < inner->prefix_.size() && inner->prefix_[matched] == key[depth + matched])
+        {
+          matched++;
+        }
+        if (matched < inner->prefix_.size())
+        {
+          // split the prefix where the key leaves it
+          leaf = new LeafT(keyValuePair, key);
+          RadixNode4<Key, Value>* split = new RadixNode4<Key, Value>();
+          split->prefix_ = inner->prefix_.substr(0, matched);
+          uint8_t innerByte = (uint8_t)inner->prefix_[matched];
+          inner->prefix_.erase(0, matched + 1);
+          addChild(ref, split, innerByte, inner);
+          addChild(ref, split, (uint8_t)key[depth + matched], leaf);
+          *ref = split;
+        }
+        else
+        {
+          depth += inner->prefix_.size();
+          NodeT** child = findChild(inner, (uint8_t)key[depth]);
+          if (child == NULL)
+          {
+            leaf = new LeafT(keyValuePair, key);
+            addChild(ref, inner, (uint8_t)key[depth], leaf);
+          }
+          else
+          {
+            ref = child;
+            depth++;
+          }
+        }
+      }
+    }
+
+    // chain the leaf in front of the first key above it
+    LeafT* next = bound(root_, key, 0, true);
+    LeafT* prev = (next != NULL) ? next->prev_ : tail_;
+    leaf->prev_ = prev;
+    leaf->next_ = next;
+    if (prev != NULL) prev->next_ = leaf;
+    else head_ = leaf;
+    if (next != NULL) next->prev_ = leaf;
+    else tail_ = leaf;
+    size_++;
+}
+
+/*
+ * Unlinks the leaf from its parent, which may shrink to a smaller node type
+ * or, left with a single child, fold into it.
+ */
+template<class Key, class Value>
+void AdaptiveRadixTree<Key, Value>::remove(const Key& key)
+{
+    std::string bytes;
+    RadixKey<Key>::encode(key, bytes);
+
+    NodeT** ref = &root_;
+    NodeT** parentRef = NULL;
+    size_t depth = 0;
+    while (*ref != NULL && (*ref)->type_ != radixLeaf)
+    {
+      InnerT* inner = static_cast<InnerT*>(*ref);
+      if (bytes.compare(depth, inner->prefix_.size(), inner->prefix_) != 0) return;
+      depth += inner->prefix_.size();
+      NodeT** child = findChild(inner, (uint8_t)bytes[depth]);
+      if (child == NULL) return;
+      parentRef = ref;
+      ref = child;
+      depth++;
+    }
+    if (*ref == NULL) return;
+    LeafT* leaf = static_cast<LeafT*>(*ref);
+    if (leaf->key_ != bytes) return;
+
+    if (leaf->prev_ != NULL) leaf->prev_->next_ = leaf->next_;
+    else head_ = leaf->next_;
+    if (leaf->next_ != NULL) leaf->next_->prev_ = leaf->prev_;
+    else tail_ = leaf->prev_;
+
+    if (parentRef == NULL) root_ = NULL;
+    else removeChild(parentRef, static_cast<InnerT*>(*parentRef), (uint8_t)bytes[depth - 1]);
+    delete leaf;
+    size_--;
+}
+
+/*
+ * Removes every key k with lo <= k <= hi, walking the leaf chain from the
+ * first one in range.
+ */
+template<class Key, class Value>
+void AdaptiveRadixTree<Key, Value>::erase(const Key& lo, const Key& hi)
+{
+    if (hi < lo) return;
+    std::string bytes;
+    RadixKey<Key>::encode(lo, bytes);
+    LeafT* leaf = bound(root_, bytes, 0, false);
+    while (leaf != NULL && !(hi < leaf->item_.first))
+    {
+      LeafT* next = leaf->next_;
+      Key key = leaf->item_.first;
+      remove(key);
+      leaf = next;
+    }
+}
+
+template<class Key, class Value>
+void AdaptiveRadixTree<Key, Value>::clear()
+{
+    freeNode(root_);
+    root_ = NULL;
+    head_ = NULL;
+    tail_ = NULL;
+    size_ = 0;
+}
+
+template<class Key, class Value>
+RadixLeaf<Key, Value>* AdaptiveRadixTree<Key, Value>::findLeaf(const std::string& key) const
+{
+    NodeT* n = root_;
+    size_t depth = 0;
+    while (n != NULL && n->type_ != radixLeaf)
+    {
+      InnerT* inner = static_cast<InnerT*>(n);
+      if (key.compare(depth, inner->prefix_.size(), inner->prefix_) != 0) return NULL;
+      depth += inner->prefix_.size();
+      NodeT** child = findChild(inner, (uint8_t)key[depth]);
+      if (child == NULL) return NULL;
+      n = *child;
+      depth++;
+    }
+    if (n == NULL) return NULL;
+    LeafT* leaf = static_cast<LeafT*>(n);
+    return (leaf->key_ == key) ? leaf : NULL;
+}
+
+/*
+ * Returns the first leaf in n's subtree whose key is at least key (above
+ * key, if strict), or NULL. depth is how many bytes led to n.
+ */
+template<class Key, class Value>
+RadixLeaf<Key, Value>* AdaptiveRadixTree<Key, Value>::bound(NodeT* n, const std::string& key, size_t depth, bool strict)
+{
+    if (n == NULL) return NULL;
+    if (n->type_ == radixLeaf)
+    {
+      LeafT* leaf = static_cast<LeafT*>(n);
+      int cmp = leaf->key_.compare(key);
+      return (cmp > 0 || (cmp == 0 && !strict)) ? leaf : NULL;
+    }
+
+    InnerT* inner = static_cast<InnerT*>(n);
+    int cmp = key.compare(depth, inner->prefix_.size(), inner->prefix_);
+    // every key below sorts after key, or every one before it
+    if (cmp < 0) return minLeaf(n);
+    if (cmp > 0) return NULL;
+    depth += inner->prefix_.size();
+    uint8_t byte = (uint8_t)key[depth];
+    NodeT** child = findChild(inner, byte);
+    if (child != NULL)
+    {
+      LeafT* found = bound(*child, key, depth + 1, strict);
+      if (found != NULL) return found;
+    }
+    NodeT* after = childAfter(inner, byte);
+    return (after != NULL) ? minLeaf(after) : NULL;
+}
+
+template<class Key, class Value>
+RadixLeaf<Key, Value>* AdaptiveRadixTree<Key, Value>::minLeaf(NodeT* n)
+{
+    while (n != NULL && n->type_ != radixLeaf)
+    {
+      n = childAfter(static_cast<InnerT*>(n), -1);
+    }
+    return static_cast<LeafT*>(n);
+}
+
+/*
+ * Returns the slot holding the child for byte, or NULL.
+ */
+template<class Key, class Value>
+RadixNode<Key, Value>** AdaptiveRadixTree<Key, Value>::findChild(InnerT* n, uint8_t byte)
+{
+    switch (n->type_)
+    {
+      case radixNode4:
+      {
+        RadixNode4<Key, Value>* n4 = static_cast<RadixNode4<Key, Value>*>(n);
+        for (int i = 0; i < n4->count_; ++i)
+        {
+          if (n4->keys_[i] == byte) return &n4->children_[i];
+        }
+        return NULL;
+      }
+      case radixNode16:
+      {
+        RadixNode16<Key, Value>* n16 = static_cast<RadixNode16<Key, Value>*>(n);
+#if defined(__SSE2__)
+        // compare all sixteen keys at once
+        __m128i hits = _mm_cmpeq_epi8(_mm_set1_epi8((char)byte),
+                                      _mm_loadu_si128((const __m128i*)n16->keys_));
+        int mask = _mm_movemask_epi8(hits) & ((1 << n16->count_) - 1);
+        if (mask != 0) return &n16->children_[__builtin_ctz(mask)];
+#else
+        for (int i = 0; i < n16->count_; ++i)
+        {
+          if (n16->keys_[i] == byte) return &n16->children_[i];
+        }
+#endif
+        return NULL;
+      }
+      case radixNode48:
+      {
+        RadixNode48<Key, Value>* n48 = static_cast<RadixNode48<Key, Value>*>(n);
+        if (n48->index_[byte] == 0) return NULL;
+        return &n48->children_[n48->index_[byte] - 1];
+      }
+      default:
+      {
+        RadixNode256<Key, Value>* n256 = static_cast<RadixNode256<Key, Value>*>(n);
+        if (n256->children_[byte] == NULL) return NULL;
+        return &n256->children_[byte];
+      }
+    }
+}
+
+/*
+ * Returns the child with the smallest byte above byte (pass -1 for the
+ * first child), or NULL.
+ */
+template<class Key, class Value>
+RadixNode<Key, Value>* AdaptiveRadixTree<Key, Value>::childAfter(InnerT* n, int byte)
+{
+    switch (n->type_)
+    {
+      case radixNode4:
+      {
+        RadixNode4<Key, Value>* n4 = static_cast<RadixNode4<Key, Value>*>(n);
+        for (int i = 0; i < n4->count_; ++i)
+        {
+          if (n4->keys_[i] > byte) return n4->children_[i];
+        }
+        return NULL;
+      }
+      case radixNode16:
+      {
+        RadixNode16<Key, Value>* n16 = static_cast<RadixNode16<Key, Value>*>(n);
+        for (int i = 0; i < n16->count_; ++i)
+        {
+          if (n16->keys_[i] > byte) return n16->children_[i];
+        }
+        return NULL;
+      }
+      case radixNode48:
+      {
+        RadixNode48<Key, Value>* n48 = static_cast<RadixNode48<Key, Value>*>(n);
+        for (int b = byte + 1; b < 256; ++b)
+        {
+          if (n48->index_[b] != 0) return n48->children_[n48->index_[b] - 1];
+        }
+        return NULL;
+      }
+      default:
+      {
+        RadixNode256<Key, Value>* n256 = static_cast<RadixNode256<Key, Value>*>(n);
+        for (int b = byte + 1; b < 256; ++b)
+        {
+          if (n256->children_[b] != NULL) return n256->children_[b];
+        }
+        return NULL;
+      }
+    }
+}
+
+/*
+ * Adds child under byte, which must be free. A full node is replaced, in
+ * *ref, by the next larger type.
+ */
+template<class Key, class Value>
+void AdaptiveRadixTree<Key, Value>::addChild(NodeT** ref, InnerT* n, uint8_t byte, NodeT* child)
+{
+    switch (n->type_)
+    {
+      case radixNode4:
+      {
+        RadixNode4<Key, Value>* n4 = static_cast<RadixNode4<Key, Value>*>(n);
+        if (n4->count_ < 4)
+        {
+          int pos = 0;
+          while (pos < n4->count_ && n4->keys_[pos] < byte) pos++;
+          std::memmove(n4->keys_ + pos + 1, n4->keys_ + pos, n4->count_ - pos);
+          std::memmove(n4->children_ + pos + 1, n4->children_ + pos, (n4->count_ - pos) * sizeof(NodeT*));
+          n4->keys_[pos] = byte;
+          n4->children_[pos] = child;
+          n4->count_++;
+          return;
+        }
+        RadixNode16<Key, Value>* grown = new RadixNode16<Key, Value>();
+        std::memcpy(grown->keys_, n4->keys_, 4);
+        std::memcpy(grown->children_, n4->children_, 4 * sizeof(NodeT*));
+        grown->count_ = 4;
+        grown->prefix_.swap(n4->prefix_);
+        *ref = grown;
+        delete n4;
+        addChild(ref, grown, byte, child);
+        return;
+      }
+      case radixNode16:
+      {
+        RadixNode16<Key, Value>* n16 = static_cast<RadixNode16<Key, Value>*>(n);
+        if (n16->count_ < 16)
+        {
+          int pos = 0;
+          while (pos < n16->count_ && n16->keys_[pos] < byte) pos++;
+          std::memmove(n16->keys_ + pos + 1, n16->keys_ + pos, n16->count_ - pos);
+          std::memmove(n16->children_ + pos + 1, n16->children_ + pos, (n16->count_ - pos) * sizeof(NodeT*));
+          n16->keys_[pos] = byte;
+          n16->children_[pos] = child;
+          n16->count_++;
+          return;
+        }
+        RadixNode48<Key, Value>* grown = new RadixNode48<Key, Value>();
+        for (int i = 0; i < 16; ++i)
+        {
+          grown->index_[n16->keys_[i]] = (uint8_t)(i + 1);
+          grown->children_[i] = n16->children_[i];
+        }
+        grown->count_ = 16;
+        grown->prefix_.swap(n16->prefix_);
+        *ref = grown;
+        delete n16;
+        addChild(ref, grown, byte, child);
+        return;
+      }
+      case radixNode48:
+      {
+        RadixNode48<Key, Value>* n48 = static_cast<RadixNode48<Key, Value>*>(n);
+        if (n48->count_ < 48)
+        {
+          int slot = 0;
+          while (n48->children_[slot] != NULL) slot++;
+          n48->children_[slot] = child;
+          n48->index_[byte] = (uint8_t)(slot + 1);
+          n48->count_++;
+          return;
+        }
+        RadixNode256<Key, Value>* grown = new RadixNode256<Key, Value>();
+        for (int b = 0; b < 256; ++b)
+        {
+          if (n48->index_[b] != 0) grown->children_[b] = n48->children_[n48->index_[b] - 1];
+        }
+        grown->count_ = 48;
+        grown->prefix_.swap(n48->prefix_);
+        *ref = grown;
+        delete n48;
+        addChild(ref, grown, byte, child);
+        return;
+      }
+      default:
+      {
+        RadixNode256<Key, Value>* n256 = static_cast<RadixNode256<Key, Value>*>(n);
+        n256->children_[byte] = child;
+        n256->count_++;
+        return;
+      }
+    }
+}
+
+/*
+ * Drops the child under byte. Nodes shrink a size once well below the
+ * smaller type's capacity, so a key flapping at the boundary does not
+ * resize every time, and a Node4 left with one child folds its prefix and
+ * byte into that child.
+ */
+template<class Key, class Value>
+void AdaptiveRadixTree<Key, Value>::removeChild(NodeT** ref, InnerT* n, uint8_t byte)
+{
+    switch (n->type_)
+    {
+      case radixNode4:
+      {
+        RadixNode4<Key, Value>* n4 = static_cast<RadixNode4<Key, Value>*>(n);
+        int pos = 0;
+        while (n4->keys_[pos] != byte) pos++;
+        std::memmove(n4->keys_ + pos, n4->keys_ + pos + 1, n4->count_ - pos - 1);
+        std::memmove(n4->children_ + pos, n4->children_ + pos + 1, (n4->count_ - pos - 1) * sizeof(NodeT*));
+        n4->count_--;
+        if (n4->count_ == 1)
+        {
+          NodeT* only = n4->children_[0];
+          if (only->type_ != radixLeaf)
+          {
+            InnerT* onlyInner = static_cast<InnerT*>(only);
+            std::string prefix = n4->prefix_;
+            prefix.push_back((char)n4->keys_[0]);
+            prefix.append(onlyInner->prefix_);
+            onlyInner->prefix_.swap(prefix);
+          }
+          *ref = only;
+          delete n4;
+        }
+        return;
+      }
+      case radixNode16:
+      {
+        RadixNode16<Key, Value>* n16 = static_cast<RadixNode16<Key, Value>*>(n);
+        int pos = 0;
+        while (n16->keys_[pos] != byte) pos++;
+        std::memmove(n16->keys_ + pos, n16->keys_ + pos + 1, n16->count_ - pos - 1);
+        std::memmove(n16->children_ + pos, n16->children_ + pos + 1, (n16->count_ - pos - 1) * sizeof(NodeT*));
+        n16->count_--;
+        if (n16->count_ == 3)
+        {
+          RadixNode4<Key, Value>* shrunk = new RadixNode4<Key, Value>();
+          std::memcpy(shrunk->keys_, n16->keys_, 3);
+          std::memcpy(shrunk->children_, n16->children_, 3 * sizeof(NodeT*));
+          shrunk->count_ = 3;
+          shrunk->prefix_.swap(n16->prefix_);
+          *ref = shrunk;
+          delete n16;
+        }
+        return;
+      }
+      case radixNode48:
+      {
+        RadixNode48<Key, Value>* n48 = static_cast<RadixNode48<Key, Value>*>(n);
+        n48->children_[n48->index_[byte] - 1] = NULL;
+        n48->index_[byte] = 0;
+        n48->count_--;
+        if (n48->count_ == 12)
+        {
+          RadixNode16<Key, Value>* shrunk = new RadixNode16<Key, Value>();
+          for (int b = 0; b < 256; ++b)
+          {
+            if (n48->index_[b] == 0) continue;
+            shrunk->keys_[shrunk->count_] = (uint8_t)b;
+            shrunk->children_[shrunk->count_] = n48->children_[n48->index_[b] - 1];
+            shrunk->count_++;
+          }
+          shrunk->prefix_.swap(n48->prefix_);
+          *ref = shrunk;
+          delete n48;
+        }
+        return;
+      }
+      default:
+      {
+        RadixNode256<Key, Value>* n256 = static_cast<RadixNode256<Key, Value>*>(n);
+        n256->children_[byte] = NULL;
+        n256->count_--;
+        if (n256->count_ == 37)
+        {
+          RadixNode48<Key, Value>* shrunk = new RadixNode48<Key, Value>();
+          for (int b = 0; b < 256; ++b)
+          {
+            if (n256->children_[b] == NULL) continue;
+            shrunk->children_[shrunk->count_] = n256->children_[b];
+            shrunk->count_++;
+            shrunk->index_[b] = (uint8_t)shrunk->count_;
+          }
+          shrunk->prefix_.swap(n256->prefix_);
+          *ref = shrunk;
+          delete n256;
+        }
+        return;
+      }
+    }
+}
+
+/*
+ * Frees the subtree at n with an explicit stack, since long string keys
+ * can make paths deep.
+ */
+template<class Key, class Value>
+void AdaptiveRadixTree<Key, Value>::freeNode(NodeT* n)
+{
+    std::vector<NodeT*> pending;
+    if (n != NULL) pending.push_back(n);
+    while (!pending.empty())
+    {
+      NodeT* curr = pending.back();
+      pending.pop_back();
+      switch (curr->type_)
+      {
+        case radixLeaf:
+          delete static_cast<LeafT*>(curr);
+          break;
+        case radixNode4:
+        {
+          RadixNode4<Key, Value>* n4 = static_cast<RadixNode4<Key, Value>*>(curr);
+          pending.insert(pending.end(), n4->children_, n4->children_ + n4->count_);
+          delete n4;
+          break;
+        }
+        case radixNode16:
+        {
+          RadixNode16<Key, Value>* n16 = static_cast<RadixNode16<Key, Value>*>(curr);
+          pending.insert(pending.end(), n16->children_, n16->children_ + n16->count_);
+          delete n16;
+          break;
+        }
+        case radixNode48:
+        {
+          RadixNode48<Key, Value>* n48 = static_cast<RadixNode48<Key, Value>*>(curr);
+          for (int i = 0; i < 48; ++i)
+          {
+            if (n48->children_[i] != NULL) pending.push_back(n48->children_[i]);
+          }
+          delete n48;
+          break;
+        }
+        default:
+        {
+          RadixNode256<Key, Value>* n256 = static_cast<RadixNode256<Key, Value>*>(curr);
+          for (int b = 0; b < 256; ++b)
+          {
+            if (n256->children_[b] != NULL) pending.push_back(n256->children_[b]);
+          }
+          delete n256;
+          break;
+        }
+      }
+    }
+}
+
+
+#endif
@@ -0,0 +1,465 @@
+#ifndef RBBST_H
+#define RBBST_H
+
+#include <iostream>
+#include <exception>
+#include <cstdlib>
+#include <cstdint>
+#include "bst.h"
+
+/**
+* A special kind of node for a red black tree, which adds the color as a data member.
+*/
+template <typename Key, typename Value>
+class RBNode : public Node<Key, Value>
+{
+public:
+    enum Color { red, black };
+
+    // Constructor/destructor.
+    RBNode(const Key& key, const Value& value, RBNode<Key, Value>* parent);
+    virtual ~RBNode();
+
+    // Getter/setter for the node's color.
+    Color getColor() const;
+    void setColor(Color color);
+
+    // Getters for parent, left, and right. These need to be redefined since they
+    // return pointers to RBNodes - not plain Nodes. See the Node class in bst.h
+    // for more information.
+    virtual RBNode<Key, Value>* getParent() const override;
+    virtual RBNode<Key, Value>* getLeft() const override;
+    virtual RBNode<Key, Value>* getRight() const override;
+
+protected:
+    Color color_;
+};
+
+/*
+  -------------------------------------------------
+  Begin implementations for the RBNode class.
+  -------------------------------------------------
+*/
+
+/**
+* An explicit constructor to initialize the elements by calling the base class constructor and setting
+* the color to red since every new node will be red when it is first inserted.
+*/
+template<class Key, class Value>
+RBNode<Key, Value>::RBNode(const Key& key, const Value& value, RBNode<Key, Value> *parent) :
+    Node<Key, Value>(key, value, parent), color_(red)
+{
+
+}
+
+/**
+* A destructor which does nothing.
+*/
+template<class Key, class Value>
+RBNode<Key, Value>::~RBNode()
+{
+
+}
+
+/**
+* A getter for the color of a RBNode.
+*/
+template<class Key, class Value>
+typename RBNode<Key, Value>::Color RBNode<Key, Value>::getColor() const
+{
+    return color_;
+}
+
+/**
+* A setter for the color of a RBNode.
+*/
+template<class Key, class Value>
+void RBNode<Key, Value>::setColor(Color color)
+{
+    color_ = color;
+}
+
+/**
+* An overridden function for getting the parent since a static_cast is necessary to make sure
+* that our node is a RBNode.
+*/
+template<class Key, class Value>
+RBNode<Key, Value> *RBNode<Key, Value>::getParent() const
+{
+    return static_cast<RBNode<Key, Value>*>(this->parent_);
+}
+
+/**
+* Overridden for the same reasons as above.
+*/
+template<class Key, class Value>
+RBNode<Key, Value> *RBNode<Key, Value>::getLeft() const
+{
+    return static_cast<RBNode<Key, Value>*>(this->left_);
+}
+
+/**
+* Overridden for the same reasons as above.
+*/
+template<class Key, class Value>
+RBNode<Key, Value> *RBNode<Key, Value>::getRight() const
+{
+    return static_cast<RBNode<Key, Value>*>(this->right_);
+}
+
+
+/*
+  -----------------------------------------------
+  End implementations for the RBNode class.
+  -----------------------------------------------
+*/
+
+
+/**
+* A red black tree. Compared to AVLTree it keeps a looser balance, in exchange
+* for at most two rotations per insert and three per remove; the rest of the
+* fixup is recoloring.
+*/
+template <class Key, class Value>
+class RedBlackTree : public BinarySearchTree<Key, Value>
+{
+public:
+    RedBlackTree();
+    RedBlackTree(const RedBlackTree<Key, Value>& other);
+    RedBlackTree(RedBlackTree<Key, Value>&& other);
+    RedBlackTree<Key, Value>& operator=(const RedBlackTree<Key, Value>& other);
+    RedBlackTree<Key, Value>& operator=(RedBlackTree<Key, Value>&& other);
+
+    virtual void insert (const std::pair<const Key, Value> &new_item);
+    virtual void remove(const Key& key);
+    virtual void erase(const Key& lo, const Key& hi);
+protected:
+    virtual void nodeSwap( RBNode<Key,Value>* n1, RBNode<Key,Value>* n2);
+    virtual Node<Key, Value>* cloneNode(const Node<Key, Value>* src, Node<Key, Value>* parent) const;
+
+    RBNode<Key, Value>* conversion(Node<Key, Value>* n) const;
+    static bool isRed(RBNode<Key, Value>* n);
+    void insertFix(RBNode<Key, Value>* n);
+    void removeFix(RBNode<Key, Value>* n, RBNode<Key, Value>* p);
+    void removeNode(RBNode<Key, Value>* removal);
+};
+
+
+template<class Key, class Value>
+RedBlackTree<Key, Value>::RedBlackTree() : BinarySearchTree<Key, Value>()
+{
+
+}
+
+/*
+ * See the AVLTree copy constructor for why the copy is made here.
+ */
+template<class Key, class Value>
+RedBlackTree<Key, Value>::RedBlackTree(const RedBlackTree<Key, Value>& other) : BinarySearchTree<Key, Value>()
+{
+    this->copyFrom(other);
+}
+
+template<class Key, class Value>
+RedBlackTree<Key, Value>::RedBlackTree(RedBlackTree<Key, Value>&& other) :
+    BinarySearchTree<Key, Value>(std::move(other))
+{
+
+}
+
+template<class Key, class Value>
+RedBlackTree<Key, Value>& RedBlackTree<Key, Value>::operator=(const RedBlackTree<Key, Value>& other)
+{
+    BinarySearchTree<Key, Value>::operator=(other);
+    return *this;
+}
+
+template<class Key, class Value>
+RedBlackTree<Key, Value>& RedBlackTree<Key, Value>::operator=(RedBlackTree<Key, Value>&& other)
+{
+    BinarySearchTree<Key, Value>::operator=(std::move(other));
+    return *this;
+}
+
+template<class Key, class Value>
+RBNode<Key, Value> *RedBlackTree<Key, Value>::conversion(Node<Key, Value>* n) const
+{
+    return static_cast<RBNode<Key, Value>*>(n);
+}
+
+/*
+ * Missing children count as black.
+ */
+template<class Key, class Value>
+bool RedBlackTree<Key, Value>::isRed(RBNode<Key, Value>* n)
+{
+    return n != NULL && n->getColor() == RBNode<Key, Value>::red;
+}
+
+template<class Key, class Value>
+Node<Key, Value>* RedBlackTree<Key, Value>::cloneNode(const Node<Key, Value>* src, Node<Key, Value>* parent) const
+{
+    RBNode<Key, Value>* n = new RBNode<Key, Value>(src->getKey(), src->getValue(), conversion(parent));
+    n->setColor(static_cast<const RBNode<Key, Value>*>(src)->getColor());
+    return n;
+}
+
+/*
+ * Recall: If key is already in the tree, you should
+ * overwrite the current value with the updated value.
+ */
+template<class Key, class Value>
+void RedBlackTree<Key, Value>::insert (const std::pair<const Key, Value> &new_item)
+{
+    RBNode<Key, Value>* parent = NULL;
+    RBNode<Key, Value>* traveler = conversion(this->root_);
+    while (traveler != NULL)
+    {
+      if (new_item.first < traveler->getKey())
+      {
+        parent = traveler;
+        traveler = traveler->getLeft();
+      }
+      else if (traveler->getKey() < new_item.first)
+      {
+        parent = traveler;
+        traveler = traveler->getRight();
+      }
+      // if key is the same, set the value
+      else
+      {
+        traveler->setValue(new_item.second);
+        return;
+      }
+    }
+
+    RBNode<Key, Value>* newNode = new RBNode<Key, Value>(new_item.first, new_item.second, parent);
+    if (parent == NULL) this->root_ = newNode;
+    else if (new_item.first < parent->getKey()) parent->setLeft(newNode);
+    else parent->setRight(newNode);
+    this->size_++;
+    insertFix(newNode);
+}
+
+/*
+ * n is red. While its parent is also red, either recolor the parent and uncle
+ * and move the problem up to the grandparent, or rotate once or twice and stop.
+ */
+template<class Key, class Value>
+void RedBlackTree<Key, Value>::insertFix(RBNode<Key, Value>* n)
+{
+  while (isRed(n->getParent()))
+  {
+    RBNode<Key, Value>* p = n->getParent();
+    // the root is black, so a red parent always has a parent
+    RBNode<Key, Value>* g = p->getParent();
+    if (g->getLeft() == p)
+    {
+      RBNode<Key, Value>* u = g->getRight();
+      if (isRed(u))
+      {
+        p->setColor(RBNode<Key, Value>::black);
+        u->setColor(RBNode<Key, Value>::black);
+        g->setColor(RBNode<Key, Value>::red);
+        n = g;
+        continue;
+      }
+      // left right case
+      if (p->getRight() == n)
+      {
+        this->rotateLeft(p);
+        p = n;
+      }
+      // left left case
+      p->setColor(RBNode<Key, Value>::black);
+      g->setColor(RBNode<Key, Value>::red);
+      this->rotateRight(g);
+      break;
+    }
+    else
+    {
+      RBNode<Key, Value>* u = g->getLeft();
+      if (isRed(u))
+      {
+        p->setColor(RBNode<Key, Value>::black);
+        u->setColor(RBNode<Key, Value>::black);
+        g->setColor(RBNode<Key, Value>::red);
+        n = g;
+        continue;
+      }
+      // right left case
+      if (p->getLeft() == n)
+      {
+        this->rotateRight(p);
+        p = n;
+      }
+      // right right case
+      p->setColor(RBNode<Key, Value>::black);
+      g->setColor(RBNode<Key, Value>::red);
+      this->rotateLeft(g);
+      break;
+    }
+  }
+  conversion(this->root_)->setColor(RBNode<Key, Value>::black);
+}
+
+/*
+ * Recall: The writeup specifies that if a node has 2 children you
+ * should swap with the predecessor and then remove.
+ */
+template<class Key, class Value>
+void RedBlackTree<Key, Value>::remove(const Key& key)
+{
+    RBNode<Key, Value>* removal = conversion(this->internalFind(key));
+    if (removal == NULL) return;
+    removeNode(removal);
+}
+
+/*
+ * Removes every key k with lo <= k <= hi. The base class split and rejoin
+ * knows nothing about colors, so this removes the range node by node.
+ */
+template<class Key, class Value>
+void RedBlackTree<Key, Value>::erase(const Key& lo, const Key& hi)
+{
+    if (hi < lo) return;
+    Node<Key, Value>* n = this->root_;
+    Node<Key, Value>* first = NULL;
+    while (n != NULL)
+    {
+      if (n->getKey() < lo) n = n->getRight();
+      else
+      {
+        first = n;
+        n = n->getLeft();
+      }
+    }
+    while (first != NULL && !(hi < first->getKey()))
+    {
+      // removeNode only ever moves the predecessor, so the successor stays put
+      Node<Key, Value>* next = first;
+      BinarySearchTree<Key, Value>::successor(next);
+      removeNode(conversion(first));
+      first = next;
+    }
+}
+
+/*
+ * Unlinks and frees the given node. Removing a black node leaves its side one
+ * black short, which removeFix repairs.
+ */
+template<class Key, class Value>
+void RedBlackTree<Key, Value>::removeNode(RBNode<Key, Value>* removal)
+{
+    // 2 child case --> swap with the predecessor, which has at most a left child
+    if (removal->getLeft() != NULL && removal->getRight() != NULL)
+    {
+      nodeSwap(removal, conversion(this->predecessor(removal)));
+    }
+
+    RBNode<Key, Value>* child = removal->getLeft();
+    if (child == NULL) child = removal->getRight();
+    RBNode<Key, Value>* p = removal->getParent();
+    if (p == NULL) this->root_ = child;
+    else if (p->getLeft() == removal) p->setLeft(child);
+    else p->setRight(child);
+    if (child != NULL) child->setParent(p);
+
+    if (removal->getColor() == RBNode<Key, Value>::black)
+    {
+      if (isRed(child)) child->setColor(RBNode<Key, Value>::black);
+      else removeFix(child, p);
+    }
+    delete removal;
+    this->size_--;
+}
+
+/*
+ * n (possibly NULL, with parent p) is one black short of its sibling's side.
+ * Recoloring can push the shortage up the tree; any rotation ends the fix.
+ */
+template<class Key, class Value>
+void RedBlackTree<Key, Value>::removeFix(RBNode<Key, Value>* n, RBNode<Key, Value>* p)
+{
+  while (n != this->root_ && !isRed(n))
+  {
+    if (p->getLeft() == n)
+    {
+      // the sibling side is at least one black deep, so it exists
+      RBNode<Key, Value>* s = p->getRight();
+      if (isRed(s))
+      {
+        s->setColor(RBNode<Key, Value>::black);
+        p->setColor(RBNode<Key, Value>::red);
+        this->rotateLeft(p);
+        s = p->getRight();
+      }
+      if (!isRed(s->getLeft()) && !isRed(s->getRight()))
+      {
+        s->setColor(RBNode<Key, Value>::red);
+        n = p;
+        p = n->getParent();
+        continue;
+      }
+      if (!isRed(s->getRight()))
+      {
+        s->getLeft()->setColor(RBNode<Key, Value>::black);
+        s->setColor(RBNode<Key, Value>::red);
+        this->rotateRight(s);
+        s = p->getRight();
+      }
+      s->setColor(p->getColor());
+      p->setColor(RBNode<Key, Value>::black);
+      s->getRight()->setColor(RBNode<Key, Value>::black);
+      this->rotateLeft(p);
+      n = conversion(this->root_);
+    }
+    // this is the mirror case
+    else
+    {
+      RBNode<Key, Value>* s = p->getLeft();
+      if (isRed(s))
+      {
+        s->setColor(RBNode<Key, Value>::black);
+        p->setColor(RBNode<Key, Value>::red);
+        this->rotateRight(p);
+        s = p->getLeft();
+      }
+      if (!isRed(s->getLeft()) && !isRed(s->getRight()))
+      {
+        s->setColor(RBNode<Key, Value>::red);
+        n = p;
+        p = n->getParent();
+        continue;
+      }
+      if (!isRed(s->getLeft()))
+      {
+        s->getRight()->setColor(RBNode<Key, Value>::black);
+        s->setColor(RBNode<Key, Value>::red);
+        this->rotateLeft(s);
+        s = p->getLeft();
+      }
+      s->setColor(p->getColor());
+      p->setColor(RBNode<Key, Value>::black);
+      s->getLeft()->setColor(RBNode<Key, Value>::black);
+      this->rotateRight(p);
+      n = conversion(this->root_);
+    }
+  }
+  if (n != NULL) n->setColor(RBNode<Key, Value>::black);
+}
+
+/*
+ * Colors belong to positions in the tree, so they are swapped along with the nodes.
+ */
+template<class Key, class Value>
+void RedBlackTree<Key, Value>::nodeSwap( RBNode<Key,Value>* n1, RBNode<Key,Value>* n2)
+{
+    BinarySearchTree<Key, Value>::nodeSwap(n1, n2);
+    typename RBNode<Key, Value>::Color tempC = n1->getColor();
+    n1->setColor(n2->getColor());
+    n2->setColor(tempC);
+}
+
+
+#endif
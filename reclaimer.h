@@ -0,0 +1,158 @@
+#ifndef RECLAIMER_H
+#define RECLAIMER_H
+
+#include <cstddef>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <deque>
+
+/**
+* A thread that frees detached trees so the threads that drop them do not
+* have to. Each job is a cursor into a detached structure and a function
+* that frees up to sliceNodes nodes from it and returns where it stopped,
+* or NULL once nothing is left. Jobs take turns a slice at a time, so one
+* huge tree does not hold up the small ones behind it, and the lock is
+* never held while freeing.
+*
+* The destructors of the keys and values run on the reclaimer's thread.
+* The thread starts on first use and at exit finishes everything queued;
+* jobs submitted after that are freed on the caller's thread.
+*/
+class BackgroundReclaimer
+{
+public:
+    typedef void* (*FreeSlice)(void* cursor, size_t budget);
+    static const size_t sliceNodes = 4096;
+
+    static void submit(void* cursor, FreeSlice freeSlice);
+    static void drain();
+    static size_t pending();
+
+protected:
+    struct Job
+    {
+      void* cursor_;
+      FreeSlice freeSlice_;
+    };
+
+    BackgroundReclaimer();
+    ~BackgroundReclaimer();
+    static BackgroundReclaimer& instance();
+    // set once the shared reclaimer has been torn down at exit
+    static std::atomic<bool>& shutDown()
+    {
+      static std::atomic<bool> down(false);
+      return down;
+    }
+    void run();
+
+    BackgroundReclaimer(const BackgroundReclaimer&);
+    BackgroundReclaimer& operator=(const BackgroundReclaimer&);
+
+    std::mutex lock_;
+    std::condition_variable wake_;
+    std::condition_variable idle_;
+    std::deque<Job> jobs_;
+    // a slice is being freed outside the lock
+    bool busy_;
+    bool stop_;
+    std::thread thread_;
+};
+
+
+inline BackgroundReclaimer::BackgroundReclaimer() : busy_(false), stop_(false),
+    thread_(&BackgroundReclaimer::run, this)
+{
+}
+
+/*
+ * Finishes every queued job, then stops the thread.
+ */
+inline BackgroundReclaimer::~BackgroundReclaimer()
+{
+    shutDown().store(true);
+    {
+      std::lock_guard<std::mutex> guard(lock_);
+      stop_ = true;
+    }
+    wake_.notify_all();
+    thread_.join();
+}
+
+inline BackgroundReclaimer& BackgroundReclaimer::instance()
+{
+    static BackgroundReclaimer reclaimer;
+    return reclaimer;
+}
+
+/*
+ * Queues the structure at cursor to be freed. O(1) for the caller.
+ */
+inline void BackgroundReclaimer::submit(void* cursor, FreeSlice freeSlice)
+{
+    if (cursor == NULL) return;
+    if (!shutDown().load())
+    {
+      BackgroundReclaimer& reclaimer = instance();
+      std::lock_guard<std::mutex> guard(reclaimer.lock_);
+      if (!reclaimer.stop_)
+      {
+        Job job = { cursor, freeSlice };
+        reclaimer.jobs_.push_back(job);
+        reclaimer.wake_.notify_one();
+        return;
+      }
+    }
+    while (cursor != NULL) cursor = freeSlice(cursor, sliceNodes);
+}
+
+/*
+ * Waits until everything submitted so far has been freed.
+ */
+inline void BackgroundReclaimer::drain()
+{
+    if (shutDown().load()) return;
+    BackgroundReclaimer& reclaimer = instance();
+    std::unique_lock<std::mutex> guard(reclaimer.lock_);
+    while (!reclaimer.jobs_.empty() || reclaimer.busy_) reclaimer.idle_.wait(guard);
+}
+
+/*
+ * How many jobs are queued or being freed.
+ */
+inline size_t BackgroundReclaimer::pending()
+{
+    if (shutDown().load()) return 0;
+    BackgroundReclaimer& reclaimer = instance();
+    std::lock_guard<std::mutex> guard(reclaimer.lock_);
+    return reclaimer.jobs_.size() + (reclaimer.busy_ ? 1 : 0);
+}
+
+inline void BackgroundReclaimer::run()
+{
+    std::unique_lock<std::mutex> guard(lock_);
+    while (true)
+    {
+      if (jobs_.empty())
+      {
+        idle_.notify_all();
+        if (stop_) return;
+        wake_.wait(guard);
+        continue;
+      }
+      Job job = jobs_.front();
+      jobs_.pop_front();
+      busy_ = true;
+      guard.unlock();
+      job.cursor_ = job.freeSlice_(job.cursor_, sliceNodes);
+      guard.lock();
+      busy_ = false;
+      // unfinished jobs go to the back to let the others have a turn
+      if (job.cursor_ != NULL) jobs_.push_back(job);
+    }
+}
+
+
+#endif
@@ -0,0 +1,230 @@
+#ifndef SCAPEGOATBST_H
+#define SCAPEGOATBST_H
+
+#include <iostream>
+#include <exception>
+#include <cstdlib>
+#include <cmath>
+#include <vector>
+#include <stdexcept>
+#include "bst.h"
+
+/**
+* A scapegoat tree: the plain BinarySearchTree with a rebalancing policy that
+* needs no per-node data, so it uses the plain Node. An insert that lands
+* deeper than log base 1/alpha of the size walks back up to the first
+* ancestor whose subtree is lopsided by more than alpha and rebuilds that
+* subtree perfectly balanced in linear time. Removes rebuild the whole tree
+* once enough of it is gone. Updates are O(log n) amortized and the height
+* stays O(log n).
+*
+* alpha must be in [0.5, 1): lower keeps the tree shorter at the price of
+* more rebuilding.
+*/
+template <class Key, class Value>
+class ScapegoatTree : public BinarySearchTree<Key, Value>
+{
+public:
+    ScapegoatTree(double alpha = 0.7);
+
+    virtual void insert (const std::pair<const Key, Value> &new_item);
+    virtual void remove(const Key& key);
+    virtual void erase(const Key& lo, const Key& hi);
+    void clear();
+protected:
+    size_t depthLimit() const;
+    void rebuild(Node<Key, Value>* root, size_t count);
+    static Node<Key, Value>* buildBalanced(std::vector<Node<Key, Value>*>& nodes,
+        size_t lo, size_t hi, Node<Key, Value>* parent);
+    void shrinkCheck();
+
+    double alpha_;
+    // the largest size since the last full rebuild
+    size_t maxSize_;
+};
+
+
+template<class Key, class Value>
+ScapegoatTree<Key, Value>::ScapegoatTree(double alpha) : BinarySearchTree<Key, Value>(), alpha_(alpha), maxSize_(0)
+{
+    if (!(alpha >= 0.5 && alpha < 1.0))
+    {
+      throw std::invalid_argument("Scapegoat alpha must be in [0.5, 1)");
+    }
+}
+
+/*
+ * Recall: If key is already in the tree, you should
+ * overwrite the current value with the updated value.
+ * A new node deeper than depthLimit() means some ancestor is out of
+ * alpha-balance; the nearest such one is rebuilt.
+ */
+template<class Key, class Value>
+void ScapegoatTree<Key, Value>::insert (const std::pair<const Key, Value> &new_item)
+{
+    Node<Key, Value>* parent = NULL;
+    Node<Key, Value>* traveler = this->root_;
+    size_t depth = 0;
+    while (traveler != NULL)
+    {
+      if (new_item.first < traveler->getKey())
+      {
+        parent = traveler;
+        traveler = traveler->getLeft();
+      }
+      else if (traveler->getKey() < new_item.first)
+      {
+        parent = traveler;
+        traveler = traveler->getRight();
+      }
+      // if key is the same, set the value
+      else
+      {
+        traveler->setValue(new_item.second);
+        return;
+      }
+      depth++;
+    }
+
+    Node<Key, Value>* newNode = new Node<Key, Value>(new_item.first, new_item.second, parent);
+    if (parent == NULL) this->root_ = newNode;
+    else if (new_item.first < parent->getKey()) parent->setLeft(newNode);
+    else parent->setRight(newNode);
+    this->size_++;
+    if (this->size_ > maxSize_) maxSize_ = this->size_;
+    if (depth <= depthLimit()) return;
+
+    // climb, sizing each ancestor from the child we came from and its sibling
+    Node<Key, Value>* child = newNode;
+    size_t childSize = 1;
+    while (child->getParent() != NULL)
+    {
+      Node<Key, Value>* p = child->getParent();
+      Node<Key, Value>* sibling = (p->getLeft() == child) ? p->getRight() : p->getLeft();
+      size_t pSize = 1 + childSize + this->countNodes(sibling);
+      if (childSize > alpha_ * pSize)
+      {
+        rebuild(p, pSize);
+        return;
+      }
+      child = p;
+      childSize = pSize;
+    }
+}
+
+template<class Key, class Value>
+void ScapegoatTree<Key, Value>::remove(const Key& key)
+{
+    BinarySearchTree<Key, Value>::remove(key);
+    shrinkCheck();
+}
+
+/*
+ * Removes node by node, which never makes the tree taller, then checks
+ * whether a full rebuild is due.
+ */
+template<class Key, class Value>
+void ScapegoatTree<Key, Value>::erase(const Key& lo, const Key& hi)
+{
+    if (hi < lo) return;
+    Node<Key, Value>* n = this->root_;
+    Node<Key, Value>* first = NULL;
+    while (n != NULL)
+    {
+      if (n->getKey() < lo) n = n->getRight();
+      else
+      {
+        first = n;
+        n = n->getLeft();
+      }
+    }
+    while (first != NULL && !(hi < first->getKey()))
+    {
+      // remove only ever moves the predecessor, so the successor stays put
+      Node<Key, Value>* next = first;
+      BinarySearchTree<Key, Value>::successor(next);
+      Key key = first->getKey();
+      BinarySearchTree<Key, Value>::remove(key);
+      first = next;
+    }
+    shrinkCheck();
+}
+
+template<class Key, class Value>
+void ScapegoatTree<Key, Value>::clear()
+{
+    BinarySearchTree<Key, Value>::clear();
+    maxSize_ = 0;
+}
+
+/*
+ * The deepest an alpha-balanced tree of the current size may be:
+ * floor(log base 1/alpha of size).
+ */
+template<class Key, class Value>
+size_t ScapegoatTree<Key, Value>::depthLimit() const
+{
+    if (this->size_ < 2) return 0;
+    return (size_t)std::floor(std::log((double)this->size_) / std::log(1.0 / alpha_));
+}
+
+/*
+ * Once the tree has shrunk below alpha of its peak size, depths measured
+ * against the peak no longer bound it, so the whole tree is rebuilt.
+ */
+template<class Key, class Value>
+void ScapegoatTree<Key, Value>::shrinkCheck()
+{
+    if (this->size_ < alpha_ * maxSize_)
+    {
+      rebuild(this->root_, this->size_);
+      maxSize_ = this->size_;
+    }
+}
+
+/*
+ * Rebuilds the count-node subtree at root into a perfectly balanced one in
+ * O(count): the nodes are gathered in order and relinked, never copied.
+ */
+template<class Key, class Value>
+void ScapegoatTree<Key, Value>::rebuild(Node<Key, Value>* root, size_t count)
+{
+    if (root == NULL) return;
+    Node<Key, Value>* parent = root->getParent();
+    bool onLeft = (parent != NULL && parent->getLeft() == root);
+
+    std::vector<Node<Key, Value>*> nodes;
+    nodes.reserve(count);
+    Node<Key, Value>* n = root;
+    while (n->getLeft() != NULL) n = n->getLeft();
+    for (size_t i = 0; i < count; ++i)
+    {
+      nodes.push_back(n);
+      BinarySearchTree<Key, Value>::successor(n);
+    }
+
+    Node<Key, Value>* top = buildBalanced(nodes, 0, count, parent);
+    if (parent == NULL) this->root_ = top;
+    else if (onLeft) parent->setLeft(top);
+    else parent->setRight(top);
+}
+
+/*
+ * Links nodes[lo, hi) into a balanced subtree under parent and returns its
+ * root. The recursion depth is only log of the count.
+ */
+template<class Key, class Value>
+Node<Key, Value>* ScapegoatTree<Key, Value>::buildBalanced(std::vector<Node<Key, Value>*>& nodes,
+    size_t lo, size_t hi, Node<Key, Value>* parent)
+{
+    if (lo >= hi) return NULL;
+    size_t mid = lo + (hi - lo) / 2;
+    Node<Key, Value>* n = nodes[mid];
+    n->setParent(parent);
+    n->setLeft(buildBalanced(nodes, lo, mid, n));
+    n->setRight(buildBalanced(nodes, mid + 1, hi, n));
+    return n;
+}
+
+
+#endif
@@ -0,0 +1,424 @@
+#ifndef SHARDEDMAP_H
+#define SHARDEDMAP_H
+
+#include <iostream>
+#include <exception>
+#include <cstdlib>
+#include <vector>
+#include <utility>
+#include <stdexcept>
+#include <atomic>
+#include <pthread.h>
+#include "avlbst.h"
+#include "epoch.h"
+
+/**
+* A reader-writer lock. C++11 has no shared mutex, so this wraps the POSIX
+* one the build already links against for -pthread.
+*/
+class RWLock
+{
+public:
+    RWLock() { pthread_rwlock_init(&lock_, NULL); }
+    ~RWLock() { pthread_rwlock_destroy(&lock_); }
+    void lockShared() { pthread_rwlock_rdlock(&lock_); }
+    void unlockShared() { pthread_rwlock_unlock(&lock_); }
+    void lock() { pthread_rwlock_wrlock(&lock_); }
+    void unlock() { pthread_rwlock_unlock(&lock_); }
+private:
+    RWLock(const RWLock&);
+    RWLock& operator=(const RWLock&);
+    pthread_rwlock_t lock_;
+};
+
+// Holds a lock for reading until the end of the scope
+class SharedGuard
+{
+public:
+    SharedGuard(RWLock& lock) : lock_(lock) { lock_.lockShared(); }
+    ~SharedGuard() { lock_.unlockShared(); }
+private:
+    SharedGuard(const SharedGuard&);
+    SharedGuard& operator=(const SharedGuard&);
+    RWLock& lock_;
+};
+
+// Holds a lock for writing until the end of the scope
+class ExclusiveGuard
+{
+public:
+    ExclusiveGuard(RWLock& lock) : lock_(lock) { lock_.lock(); }
+    ~ExclusiveGuard() { lock_.unlock(); }
+private:
+    ExclusiveGuard(const ExclusiveGuard&);
+    ExclusiveGuard& operator=(const ExclusiveGuard&);
+    RWLock& lock_;
+};
+
+/**
+* A thread-safe ordered map that splits the key space into ranges, each
+* held by its own AVLTree behind its own reader-writer lock, so threads
+* working on different ranges never wait for each other and lookups in the
+* same range run side by side.
+*
+* Shard i holds the keys from its low key (none for shard 0) up to the next
+* shard's. The shard list is an immutable table that splitShard and
+* mergeShards replace wholesale and retire through an EpochReclaimer, so
+* single-key operations read it with no shared lock: they pick a shard from
+* the table, lock just that shard, and check under its lock that the shard
+* still covers their key, retrying on the new table if a split or merge got
+* there first. Whole-map reads (size, forEach) and the splits and merges
+* themselves still serialize on shardsLock_, so a traversal sees a fixed
+* set of shards.
+*
+* Lookups copy the value out rather than handing back an iterator, since
+* an iterator would outlive the shard lock. Ordered traversal goes through
+* forEach, which holds each shard's read lock while visiting it.
+*/
+template <class Key, class Value>
+class ShardedAVLMap
+{
+public:
+    ShardedAVLMap();
+    ShardedAVLMap(const std::vector<Key>& splitKeys);
+    ~ShardedAVLMap();
+
+    void insert(const std::pair<const Key, Value>& keyValuePair);
+    void remove(const Key& key);
+    bool find(const Key& key, Value& value) const;
+    bool contains(const Key& key) const;
+    size_t size() const;
+    bool empty() const;
+
+    template <class Visitor>
+    void forEach(Visitor visit) const;
+    template <class Visitor>
+    void forEach(const Key& lo, const Key& hi, Visitor visit) const;
+
+    void splitShard(const Key& key);
+    void mergeShards(size_t index);
+    size_t shardCount() const;
+    size_t shardSize(size_t index) const;
+
+protected:
+    /*
+     * low_ never changes once the shard is published. The upper bound and
+     * dead_ change only under the shard's exclusive lock, which is where
+     * owns() reads them.
+     */
+    struct Shard
+    {
+      Shard() : hasLow_(false), hasHigh_(false), dead_(false) { }
+      Shard(const Key& low) : low_(low), hasLow_(true), hasHigh_(false), dead_(false) { }
+      bool owns(const Key& key) const
+      {
+        return !dead_ && (!hasLow_ || !(key < low_)) && (!hasHigh_ || key < high_);
+      }
+      mutable RWLock lock_;
+      AVLTree<Key, Value> tree_;
+      Key low_;
+      Key high_;
+      bool hasLow_;
+      bool hasHigh_;
+      // merged away; waits in the reclaimer for readers still holding it
+      bool dead_;
+    };
+    struct Table
+    {
+      std::vector<Shard*> shards_;
+    };
+
+    static size_t shardFor(const Table* table, const Key& key);
+    void publish(Table* table);
+
+    ShardedAVLMap(const ShardedAVLMap<Key, Value>&);
+    ShardedAVLMap<Key, Value>& operator=(const ShardedAVLMap<Key, Value>&);
+
+    // taken shared by whole-map reads and exclusively by splits and merges
+    mutable RWLock shardsLock_;
+    mutable EpochReclaimer reclaimer_;
+    std::atomic<Table*> table_;
+};
+
+
+template<class Key, class Value>
+ShardedAVLMap<Key, Value>::ShardedAVLMap()
+{
+    Table* table = new Table();
+    table->shards_.push_back(new Shard());
+    table_.store(table);
+}
+
+/*
+ * Starts with one shard below the first split key and one from each split
+ * key up. The split keys must be increasing.
+ */
+template<class Key, class Value>
+ShardedAVLMap<Key, Value>::ShardedAVLMap(const std::vector<Key>& splitKeys)
+{
+    Table* table = new Table();
+    table->shards_.push_back(new Shard());
+    for (size_t i = 0; i < splitKeys.size(); ++i)
+    {
+      if (i > 0 && !(splitKeys[i - 1] < splitKeys[i]))
+      {
+        for (size_t j = 0; j < table->shards_.size(); ++j) delete table->shards_[j];
+        delete table;
+        throw std::invalid_argument("Shard split keys must be increasing");
+      }
+      Shard* below = table->shards_.back();
+      below->high_ = splitKeys[i];
+      below->hasHigh_ = true;
+      table->shards_.push_back(new Shard(splitKeys[i]));
+    }
+    table_.store(table);
+}
+
+/*
+ * No other thread may be using the map. Retired tables and shards go with
+ * the reclaimer.
+ */
+template<class Key, class Value>
+ShardedAVLMap<Key, Value>::~ShardedAVLMap()
+{
+    Table* table = table_.load();
+    for (size_t i = 0; i < table->shards_.size(); ++i) delete table->shards_[i];
+    delete table;
+}
+
+/*
+ * Index of the last shard in table whose low key is not above key.
+ */
+template<class Key, class Value>
+size_t ShardedAVLMap<Key, Value>::shardFor(const Table* table, const Key& key)
+{
+    const std::vector<Shard*>& shards = table->shards_;
+    size_t lo = 0;
+    size_t hi = shards.size();
+    while (hi - lo > 1)
+    {
+      size_t mid = lo + (hi - lo) / 2;
+      if (key < shards[mid]->low_) hi = mid;
+      else lo = mid;
+    }
+    return lo;
+}
+
+/*
+ * Swaps in a new shard table. Callers hold shardsLock_ exclusively and the
+ * locks of every shard whose range changed, so a reader that fails owns()
+ * on one of them finds the new table once it gets the lock.
+ */
+template<class Key, class Value>
+void ShardedAVLMap<Key, Value>::publish(Table* table)
+{
+    reclaimer_.retire(table_.exchange(table));
+}
+
+template<class Key, class Value>
+void ShardedAVLMap<Key, Value>::insert(const std::pair<const Key, Value>& keyValuePair)
+{
+    EpochGuard pin(reclaimer_);
+    while (true)
+    {
+      Table* table = table_.load(std::memory_order_acquire);
+      Shard* shard = table->shards_[shardFor(table, keyValuePair.first)];
+      ExclusiveGuard guard(shard->lock_);
+      if (!shard->owns(keyValuePair.first)) continue;
+      shard->tree_.insert(keyValuePair);
+      return;
+    }
+}
+
+template<class Key, class Value>
+void ShardedAVLMap<Key, Value>::remove(const Key& key)
+{
+    EpochGuard pin(reclaimer_);
+    while (true)
+    {
+      Table* table = table_.load(std::memory_order_acquire);
+      Shard* shard = table->shards_[shardFor(table, key)];
+      ExclusiveGuard guard(shard->lock_);
+      if (!shard->owns(key)) continue;
+      shard->tree_.remove(key);
+      return;
+    }
+}
+
+/*
+ * Copies the value for key into value and returns true, or returns false
+ * if the key is absent.
+ */
+template<class Key, class Value>
+bool ShardedAVLMap<Key, Value>::find(const Key& key, Value& value) const
+{
+    EpochGuard pin(reclaimer_);
+    while (true)
+    {
+      const Table* table = table_.load(std::memory_order_acquire);
+      const Shard* shard = table->shards_[shardFor(table, key)];
+      SharedGuard guard(shard->lock_);
+      if (!shard->owns(key)) continue;
+      typename AVLTree<Key, Value>::iterator it = shard->tree_.find(key);
+      if (it == shard->tree_.end()) return false;
+      value = it->second;
+      return true;
+    }
+}
+
+template<class Key, class Value>
+bool ShardedAVLMap<Key, Value>::contains(const Key& key) const
+{
+    EpochGuard pin(reclaimer_);
+    while (true)
+    {
+      const Table* table = table_.load(std::memory_order_acquire);
+      const Shard* shard = table->shards_[shardFor(table, key)];
+      SharedGuard guard(shard->lock_);
+      if (!shard->owns(key)) continue;
+      return shard->tree_.find(key) != shard->tree_.end();
+    }
+}
+
+/*
+ * The total over all shards. Each shard is read under its lock, but
+ * updates elsewhere may land while the total is summed.
+ */
+template<class Key, class Value>
+size_t ShardedAVLMap<Key, Value>::size() const
+{
+    SharedGuard shards(shardsLock_);
+    const Table* table = table_.load();
+    size_t total = 0;
+    for (size_t i = 0; i < table->shards_.size(); ++i)
+    {
+      SharedGuard guard(table->shards_[i]->lock_);
+      total += table->shards_[i]->tree_.size();
+    }
+    return total;
+}
+
+template<class Key, class Value>
+bool ShardedAVLMap<Key, Value>::empty() const
+{
+    return size() == 0;
+}
+
+/*
+ * Calls visit(key, value) for every item in key order. Each shard is read
+ * locked while it is visited, so visit must not modify this map.
+ */
+template<class Key, class Value>
+template<class Visitor>
+void ShardedAVLMap<Key, Value>::forEach(Visitor visit) const
+{
+    SharedGuard shards(shardsLock_);
+    const Table* table = table_.load();
+    for (size_t i = 0; i < table->shards_.size(); ++i)
+    {
+      SharedGuard guard(table->shards_[i]->lock_);
+      const AVLTree<Key, Value>& tree = table->shards_[i]->tree_;
+      for (typename AVLTree<Key, Value>::iterator it = tree.begin(); it != tree.end(); ++it)
+      {
+        visit(it->first, it->second);
+      }
+    }
+}
+
+/*
+ * Calls visit(key, value) for every item with lo <= key <= hi, in key
+ * order, visiting only the shards that overlap the range. Each shard is
+ * entered with a lower-bound descent, so the cost is O(log n + k).
+ */
+template<class Key, class Value>
+template<class Visitor>
+void ShardedAVLMap<Key, Value>::forEach(const Key& lo, const Key& hi, Visitor visit) const
+{
+    if (hi < lo) return;
+    SharedGuard shards(shardsLock_);
+    const Table* table = table_.load();
+    for (size_t i = shardFor(table, lo); i < table->shards_.size(); ++i)
+    {
+      const Shard* shard = table->shards_[i];
+      if (shard->hasLow_ && hi < shard->low_) break;
+      SharedGuard guard(shard->lock_);
+      const AVLTree<Key, Value>& tree = shard->tree_;
+      for (typename AVLTree<Key, Value>::iterator it = tree.lower_bound(lo); it != tree.end(); ++it)
+      {
+        if (hi < it->first) break;
+        visit(it->first, it->second);
+      }
+    }
+}
+
+/*
+ * Splits the shard holding key so that key starts a new shard. Blocks
+ * operations on that shard only for the O(log n) tree split plus the count
+ * of the moved keys. Does nothing if key already starts a shard.
+ */
+template<class Key, class Value>
+void ShardedAVLMap<Key, Value>::splitShard(const Key& key)
+{
+    ExclusiveGuard shards(shardsLock_);
+    Table* table = table_.load();
+    size_t index = shardFor(table, key);
+    Shard* shard = table->shards_[index];
+    if (shard->hasLow_ && !(shard->low_ < key)) return;
+
+    Table* next = new Table(*table);
+    Shard* upper = new Shard(key);
+    ExclusiveGuard guard(shard->lock_);
+    upper->tree_ = shard->tree_.splitOff(key);
+    upper->high_ = shard->high_;
+    upper->hasHigh_ = shard->hasHigh_;
+    shard->high_ = key;
+    shard->hasHigh_ = true;
+    next->shards_.insert(next->shards_.begin() + index + 1, upper);
+    publish(next);
+}
+
+/*
+ * Folds shard index + 1 into shard index.
+ */
+template<class Key, class Value>
+void ShardedAVLMap<Key, Value>::mergeShards(size_t index)
+{
+    ExclusiveGuard shards(shardsLock_);
+    Table* table = table_.load();
+    if (index + 1 >= table->shards_.size()) throw std::out_of_range("No shard to merge with");
+    Shard* lower = table->shards_[index];
+    Shard* upper = table->shards_[index + 1];
+
+    Table* next = new Table(*table);
+    next->shards_.erase(next->shards_.begin() + index + 1);
+    {
+      ExclusiveGuard lowerGuard(lower->lock_);
+      ExclusiveGuard upperGuard(upper->lock_);
+      lower->tree_.concat(upper->tree_);
+      lower->high_ = upper->high_;
+      lower->hasHigh_ = upper->hasHigh_;
+      upper->dead_ = true;
+      publish(next);
+    }
+    reclaimer_.retire(upper);
+}
+
+template<class Key, class Value>
+size_t ShardedAVLMap<Key, Value>::shardCount() const
+{
+    SharedGuard shards(shardsLock_);
+    return table_.load()->shards_.size();
+}
+
+template<class Key, class Value>
+size_t ShardedAVLMap<Key, Value>::shardSize(size_t index) const
+{
+    SharedGuard shards(shardsLock_);
+    const Table* table = table_.load();
+    if (index >= table->shards_.size()) throw std::out_of_range("Invalid shard");
+    SharedGuard guard(table->shards_[index]->lock_);
+    return table->shards_[index]->tree_.size();
+}
+
+
+#endif
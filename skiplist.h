@@ -0,0 +1,439 @@
+#ifndef SKIPLIST_H
+#define SKIPLIST_H
+
+#include <iostream>
+#include <exception>
+#include <cstdlib>
+#include <cstdint>
+#include <new>
+#include <atomic>
+#include <memory>
+#include <utility>
+#include <stdexcept>
+#include "epoch.h"
+
+/*
+ * A skip list node and its tower of next pointers, allocated in one block
+ * with the tower straight after the node. The low bit of a next pointer
+ * marks the node as deleted at that level.
+ *
+ * The item lives behind its own pointer so that overwriting a value swaps
+ * in a new item rather than writing over one a reader may be looking at.
+ * owners_ counts the inserter, still linking the upper levels, and the
+ * eventual remover; whichever finishes last retires the node.
+ */
+template <class Key, class Value>
+struct SkipNode
+{
+    static SkipNode<Key, Value>* create(const Key& key, std::pair<const Key, Value>* item, int levels)
+    {
+      void* block = ::operator new(sizeof(SkipNode<Key, Value>) + levels * sizeof(std::atomic<uintptr_t>));
+      SkipNode<Key, Value>* node = new (block) SkipNode<Key, Value>(key, item, levels);
+      for (int i = 0; i < levels; ++i) new (&node->next()[i]) std::atomic<uintptr_t>(0);
+      return node;
+    }
+    static void destroy(void* block)
+    {
+      SkipNode<Key, Value>* node = static_cast<SkipNode<Key, Value>*>(block);
+      delete node->item_.load();
+      node->~SkipNode();
+      ::operator delete(block);
+    }
+
+    std::atomic<uintptr_t>* next()
+    {
+      return reinterpret_cast<std::atomic<uintptr_t>*>(this + 1);
+    }
+
+    const Key key_;
+    std::atomic<std::pair<const Key, Value>*> item_;
+    std::atomic<int> owners_;
+    int levels_;
+
+private:
+    SkipNode(const Key& key, std::pair<const Key, Value>* item, int levels) :
+        key_(key), item_(item), owners_(2), levels_(levels) { }
+};
+
+/**
+* An ordered map that any number of threads may read and write at once
+* without locks, for write-heavy ingest where a balanced tree's rotations
+* would serialize. Inserts and removes work with compare-and-swap on the
+* next pointers (Harris's marked pointers, as in Fraser's and Herlihy and
+* Shavit's lock-free skip lists); a remove marks the node's tower from the
+* top down and any thread that walks past a marked node helps unlink it.
+*
+* It has the BinarySearchTree interface. Iterators walk the bottom level
+* and see the items present as they reach them. Each iterator holds an
+* epoch guard for as long as it or a copy of it lives, so the items it
+* points at stay valid. Guards on one thread share a single reader slot,
+* so any number of iterators can be open, but a long-lived one holds up
+* memory reclamation meanwhile. Items are read only through iterators.
+*/
+template <class Key, class Value>
+class ConcurrentSkipList
+{
+public:
+    static const int maxLevel = 16;
+
+    typedef SkipNode<Key, Value> Node;
+
+    /**
+    * Walks the list in key order, skipping items removed before it gets to
+    * them.
+    */
+    class iterator
+    {
+    public:
+        iterator();
+
+        const std::pair<const Key, Value>& operator*() const;
+        const std::pair<const Key, Value>* operator->() const;
+
+        bool operator==(const iterator& rhs) const;
+        bool operator!=(const iterator& rhs) const;
+
+        iterator& operator++();
+
+    protected:
+        friend class ConcurrentSkipList<Key, Value>;
+        iterator(Node* node, const std::shared_ptr<EpochGuard>& pin);
+        void skipRemoved();
+        Node* current_;
+        std::shared_ptr<EpochGuard> pin_;
+    };
+
+    ConcurrentSkipList();
+    ~ConcurrentSkipList();
+
+    void insert(const std::pair<const Key, Value>& keyValuePair);
+    void remove(const Key& key);
+    iterator find(const Key& key) const;
+    iterator lower_bound(const Key& key) const;
+    iterator begin() const;
+    iterator end() const;
+    size_t size() const;
+    bool empty() const;
+
+protected:
+    static bool marked(uintptr_t link) { return (link & 1) != 0; }
+    static Node* target(uintptr_t link) { return reinterpret_cast<Node*>(link & ~uintptr_t(1)); }
+    static uintptr_t linkTo(Node* node) { return reinterpret_cast<uintptr_t>(node); }
+
+    bool search(const Key& key, Node** preds, Node** succs) const;
+    void release(Node* node) const;
+    static int randomLevel();
+
+    ConcurrentSkipList(const ConcurrentSkipList<Key, Value>&);
+    ConcurrentSkipList<Key, Value>& operator=(const ConcurrentSkipList<Key, Value>&);
+
+    Node* head_;
+    mutable EpochReclaimer reclaimer_;
+    std::atomic<size_t> size_;
+};
+
+/*
+  ---------------------------------------------------------
+  Begin implementations for the ConcurrentSkipList class.
+  ---------------------------------------------------------
+*/
+
+template<class Key, class Value>
+ConcurrentSkipList<Key, Value>::iterator::iterator() : current_(NULL)
+{
+
+}
+
+template<class Key, class Value>
+ConcurrentSkipList<Key, Value>::iterator::iterator(Node* node, const std::shared_ptr<EpochGuard>& pin) :
+    current_(node), pin_(pin)
+{
+    skipRemoved();
+}
+
+template<class Key, class Value>
+const std::pair<const Key, Value>& ConcurrentSkipList<Key, Value>::iterator::operator*() const
+{
+    return *current_->item_.load();
+}
+
+template<class Key, class Value>
+const std::pair<const Key, Value>* ConcurrentSkipList<Key, Value>::iterator::operator->() const
+{
+    return current_->item_.load();
+}
+
+template<class Key, class Value>
+bool ConcurrentSkipList<Key, Value>::iterator::operator==(const iterator& rhs) const
+{
+    return current_ == rhs.current_;
+}
+
+template<class Key, class Value>
+bool ConcurrentSkipList<Key, Value>::iterator::operator!=(const iterator& rhs) const
+{
+    return current_ != rhs.current_;
+}
+
+template<class Key, class Value>
+typename ConcurrentSkipList<Key, Value>::iterator& ConcurrentSkipList<Key, Value>::iterator::operator++()
+{
+    current_ = target(current_->next()[0].load());
+    skipRemoved();
+    return *this;
+}
+
+/*
+ * Steps past nodes already marked as removed, and drops the pin at the end.
+ */
+template<class Key, class Value>
+void ConcurrentSkipList<Key, Value>::iterator::skipRemoved()
+{
+    while (current_ != NULL && marked(current_->next()[0].load()))
+    {
+      current_ = target(current_->next()[0].load());
+    }
+    if (current_ == NULL) pin_.reset();
+}
+
+template<class Key, class Value>
+ConcurrentSkipList<Key, Value>::ConcurrentSkipList() : size_(0)
+{
+    head_ = Node::create(Key(), NULL, maxLevel);
+}
+
+/*
+ * No other thread may be using the list.
+ */
+template<class Key, class Value>
+ConcurrentSkipList<Key, Value>::~ConcurrentSkipList()
+{
+    Node* curr = head_;
+    while (curr != NULL)
+    {
+      Node* next = target(curr->next()[0].load());
+      Node::destroy(curr);
+      curr = next;
+    }
+}
+
+/*
+ * Recall: If key is already in the tree, you should
+ * overwrite the current value with the updated value.
+ */
+template<class Key, class Value>
+void ConcurrentSkipList<Key, Value>::insert(const std::pair<const Key, Value>& keyValuePair)
+{
+    EpochGuard guard(reclaimer_);
+    const Key& key = keyValuePair.first;
+    Node* preds[maxLevel];
+    Node* succs[maxLevel];
+    int levels = randomLevel();
+    while (true)
+    {
+      std::pair<const Key, Value>* item = new std::pair<const Key, Value>(keyValuePair);
+      if (search(key, preds, succs))
+      {
+        Node* found = succs[0];
+        reclaimer_.retire(found->item_.exchange(item));
+        // a remove that got in first means the new value went nowhere
+        if (!marked(found->next()[0].load())) return;
+        continue;
+      }
+
+      Node* node = Node::create(key, item, levels);
+      for (int i = 0; i < levels; ++i) node->next()[i].store(linkTo(succs[i]));
+      uintptr_t expected = linkTo(succs[0]);
+      if (!preds[0]->next()[0].compare_exchange_strong(expected, linkTo(node)))
+      {
+        Node::destroy(node);
+        continue;
+      }
+      size_++;
+
+      // the node is in the map; the upper levels only speed up searches
+      for (int i = 1; i < levels; ++i)
+      {
+        bool linked = false;
+        while (!linked)
+        {
+          uintptr_t next = node->next()[i].load();
+          if (marked(next)) break;
+          if (target(next) != succs[i] &&
+              !node->next()[i].compare_exchange_strong(next, linkTo(succs[i]))) break;
+          expected = linkTo(succs[i]);
+          linked = preds[i]->next()[i].compare_exchange_strong(expected, linkTo(node));
+          if (!linked)
+          {
+            search(key, preds, succs);
+            if (succs[0] != node) break;
+          }
+        }
+        if (!linked) break;
+      }
+      // a remove that raced with the linking may have missed the new links
+      if (marked(node->next()[0].load())) search(key, preds, succs);
+      release(node);
+      return;
+    }
+}
+
+/*
+ * Marks the node's tower from the top down; marking the bottom level is
+ * what removes it. Then unlinks it at every level.
+ */
+template<class Key, class Value>
+void ConcurrentSkipList<Key, Value>::remove(const Key& key)
+{
+    EpochGuard guard(reclaimer_);
+    Node* preds[maxLevel];
+    Node* succs[maxLevel];
+    if (!search(key, preds, succs)) return;
+    Node* victim = succs[0];
+    for (int i = victim->levels_ - 1; i > 0; --i)
+    {
+      uintptr_t next = victim->next()[i].load();
+      while (!marked(next))
+      {
+        victim->next()[i].compare_exchange_weak(next, next | 1);
+      }
+    }
+    uintptr_t next = victim->next()[0].load();
+    while (!marked(next))
+    {
+      if (victim->next()[0].compare_exchange_weak(next, next | 1))
+      {
+        size_--;
+        search(key, preds, succs);
+        release(victim);
+        return;
+      }
+    }
+}
+
+/*
+ * Returns an iterator to the key, or end() if absent.
+ */
+template<class Key, class Value>
+typename ConcurrentSkipList<Key, Value>::iterator ConcurrentSkipList<Key, Value>::find(const Key& key) const
+{
+    iterator it = lower_bound(key);
+    if (it.current_ != NULL && key < it.current_->key_) return end();
+    return it;
+}
+
+/*
+ * Returns an iterator to the first key not below key, or end().
+ */
+template<class Key, class Value>
+typename ConcurrentSkipList<Key, Value>::iterator ConcurrentSkipList<Key, Value>::lower_bound(const Key& key) const
+{
+    std::shared_ptr<EpochGuard> pin = std::make_shared<EpochGuard>(reclaimer_);
+    Node* pred = head_;
+    Node* curr = NULL;
+    for (int i = maxLevel - 1; i >= 0; --i)
+    {
+      curr = target(pred->next()[i].load());
+      while (curr != NULL)
+      {
+        uintptr_t next = curr->next()[i].load();
+        // step over removed nodes without unlinking them
+        if (marked(next)) curr = target(next);
+        else if (curr->key_ < key)
+        {
+          pred = curr;
+          curr = target(next);
+        }
+        else break;
+      }
+    }
+    return iterator(curr, pin);
+}
+
+template<class Key, class Value>
+typename ConcurrentSkipList<Key, Value>::iterator ConcurrentSkipList<Key, Value>::begin() const
+{
+    std::shared_ptr<EpochGuard> pin = std::make_shared<EpochGuard>(reclaimer_);
+    return iterator(target(head_->next()[0].load()), pin);
+}
+
+template<class Key, class Value>
+typename ConcurrentSkipList<Key, Value>::iterator ConcurrentSkipList<Key, Value>::end() const
+{
+    return iterator();
+}
+
+template<class Key, class Value>
+size_t ConcurrentSkipList<Key, Value>::size() const
+{
+    return size_.load(std::memory_order_relaxed);
+}
+
+template<class Key, class Value>
+bool ConcurrentSkipList<Key, Value>::empty() const
+{
+    return size() == 0;
+}
+
+/*
+ * Fills preds and succs, at every level, with the last node below key and
+ * the first node not below it, unlinking marked nodes on the way. Returns
+ * true if the bottom level holds key. Callers are inside an epoch.
+ */
+template<class Key, class Value>
+bool ConcurrentSkipList<Key, Value>::search(const Key& key, Node** preds, Node** succs) const
+{
+retry:
+    Node* pred = head_;
+    for (int i = maxLevel - 1; i >= 0; --i)
+    {
+      Node* curr = target(pred->next()[i].load());
+      while (curr != NULL)
+      {
+        uintptr_t next = curr->next()[i].load();
+        if (marked(next))
+        {
+          uintptr_t expected = linkTo(curr);
+          if (!pred->next()[i].compare_exchange_strong(expected, next & ~uintptr_t(1))) goto retry;
+          curr = target(next);
+        }
+        else if (curr->key_ < key)
+        {
+          pred = curr;
+          curr = target(next);
+        }
+        else break;
+      }
+      preds[i] = pred;
+      succs[i] = curr;
+    }
+    return succs[0] != NULL && !(key < succs[0]->key_);
+}
+
+/*
+ * Drops one claim on a node; the last of its inserter and remover to let
+ * go retires it, by which time it is unlinked everywhere.
+ */
+template<class Key, class Value>
+void ConcurrentSkipList<Key, Value>::release(Node* node) const
+{
+    if (node->owners_.fetch_sub(1) == 1) reclaimer_.retire(node, &Node::destroy);
+}
+
+/*
+ * Each level up holds a quarter of the nodes of the one below.
+ */
+template<class Key, class Value>
+int ConcurrentSkipList<Key, Value>::randomLevel()
+{
+    static thread_local uint64_t state = reinterpret_cast<uintptr_t>(&state) | 1;
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    int levels = 1;
+    for (uint64_t bits = state; levels < maxLevel && (bits & 3) == 0; bits >>= 2) ++levels;
+    return levels;
+}
+
+
+#endif
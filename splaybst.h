@@ -0,0 +1,196 @@
+#ifndef SPLAYBST_H
+#define SPLAYBST_H
+
+#include <iostream>
+#include <exception>
+#include <cstdlib>
+#include <stdexcept>
+#include "bst.h"
+
+/**
+* A splay tree. Every insert, and every find or operator[] through a non-const
+* tree, rotates the node it reaches up to the root, so frequently used keys
+* stay near the top. It needs no per-node data, so it uses the plain Node.
+*
+* Lookups through a const tree (or a BinarySearchTree reference) do not
+* splay and behave like the plain tree's.
+*/
+template <class Key, class Value>
+class SplayTree : public BinarySearchTree<Key, Value>
+{
+public:
+    typedef typename BinarySearchTree<Key, Value>::iterator iterator;
+    using BinarySearchTree<Key, Value>::find;
+    using BinarySearchTree<Key, Value>::operator[];
+
+    virtual void insert (const std::pair<const Key, Value> &new_item);
+    virtual void remove(const Key& key);
+    iterator find(const Key& key);
+    Value& operator[](const Key& key);
+protected:
+    Node<Key, Value>* access(const Key& key);
+    void splay(Node<Key, Value>* n);
+};
+
+/*
+ * Recall: If key is already in the tree, you should
+ * overwrite the current value with the updated value.
+ * Either way the node ends up at the root.
+ */
+template<class Key, class Value>
+void SplayTree<Key, Value>::insert (const std::pair<const Key, Value> &new_item)
+{
+    Node<Key, Value>* parent = NULL;
+    Node<Key, Value>* traveler = this->root_;
+    while (traveler != NULL)
+    {
+      if (new_item.first < traveler->getKey())
+      {
+        parent = traveler;
+        traveler = traveler->getLeft();
+      }
+      else if (traveler->getKey() < new_item.first)
+      {
+        parent = traveler;
+        traveler = traveler->getRight();
+      }
+      // if key is the same, set the value
+      else
+      {
+        traveler->setValue(new_item.second);
+        splay(traveler);
+        return;
+      }
+    }
+
+    Node<Key, Value>* newNode = new Node<Key, Value>(new_item.first, new_item.second, parent);
+    if (parent == NULL) this->root_ = newNode;
+    else if (new_item.first < parent->getKey()) parent->setLeft(newNode);
+    else parent->setRight(newNode);
+    this->size_++;
+    splay(newNode);
+}
+
+/*
+ * Splays the key to the root, then joins its two subtrees by splaying the
+ * largest node of the left one to the top, where it has no right child.
+ */
+template<class Key, class Value>
+void SplayTree<Key, Value>::remove(const Key& key)
+{
+    Node<Key, Value>* removal = access(key);
+    if (removal == NULL) return;
+
+    Node<Key, Value>* left = removal->getLeft();
+    Node<Key, Value>* right = removal->getRight();
+    delete removal;
+    this->size_--;
+
+    if (right != NULL) right->setParent(NULL);
+    if (left == NULL)
+    {
+      this->root_ = right;
+      return;
+    }
+    left->setParent(NULL);
+    this->root_ = left;
+    Node<Key, Value>* largest = left;
+    while (largest->getRight() != NULL) largest = largest->getRight();
+    splay(largest);
+    largest->setRight(right);
+    if (right != NULL) right->setParent(largest);
+}
+
+/*
+ * Returns an iterator to the key, or end() if absent. The key (or the last
+ * node visited, on a miss) is splayed to the root.
+ */
+template<class Key, class Value>
+typename SplayTree<Key, Value>::iterator SplayTree<Key, Value>::find(const Key& key)
+{
+    return this->iteratorAt(access(key));
+}
+
+/**
+ * @precondition The key exists in the map
+ * Returns the value associated with the key, after splaying it to the root
+ */
+template<class Key, class Value>
+Value& SplayTree<Key, Value>::operator[](const Key& key)
+{
+    Node<Key, Value>* curr = access(key);
+    if(curr == NULL) throw std::out_of_range("Invalid key");
+    return curr->getValue();
+}
+
+/*
+ * Looks up key and splays the node found, or the last node visited if the
+ * key is absent, so misses also pay for themselves.
+ */
+template<class Key, class Value>
+Node<Key, Value>* SplayTree<Key, Value>::access(const Key& key)
+{
+    Node<Key, Value>* traveler = this->root_;
+    Node<Key, Value>* last = NULL;
+    while (traveler != NULL)
+    {
+      last = traveler;
+      if (key < traveler->getKey()) traveler = traveler->getLeft();
+      else if (traveler->getKey() < key) traveler = traveler->getRight();
+      else break;
+    }
+    if (last != NULL) splay(last);
+    return traveler;
+}
+
+/*
+ * Rotates n up to the root two levels at a time: zig-zig rotates the
+ * grandparent first, zig-zag rotates the parent first, and a final zig
+ * handles an odd depth.
+ */
+template<class Key, class Value>
+void SplayTree<Key, Value>::splay(Node<Key, Value>* n)
+{
+  while (n->getParent() != NULL)
+  {
+    Node<Key, Value>* p = n->getParent();
+    Node<Key, Value>* g = p->getParent();
+    bool nIsLeft = (p->getLeft() == n);
+    if (g == NULL)
+    {
+      if (nIsLeft) this->rotateRight(p);
+      else this->rotateLeft(p);
+    }
+    else if (nIsLeft == (g->getLeft() == p))
+    {
+      // zig zig case
+      if (nIsLeft)
+      {
+        this->rotateRight(g);
+        this->rotateRight(p);
+      }
+      else
+      {
+        this->rotateLeft(g);
+        this->rotateLeft(p);
+      }
+    }
+    else
+    {
+      // zig zag case
+      if (nIsLeft)
+      {
+        this->rotateRight(p);
+        this->rotateLeft(g);
+      }
+      else
+      {
+        this->rotateLeft(p);
+        this->rotateRight(g);
+      }
+    }
+  }
+}
+
+
+#endif
@@ -0,0 +1,86 @@
+#ifndef STATICMAP_H
+#define STATICMAP_H
+
+#include <cstddef>
+#include <utility>
+#include <stdexcept>
+
+/**
+* A fixed-size ordered map for tables known at build time. It is a plain
+* aggregate over a sorted array, so a constexpr instance is built by the
+* compiler from a literal list, lives in read-only data, and costs no heap
+* and no startup work:
+*
+*   constexpr StaticMap<int, const char*, 3> codes = {{
+*       {200, "OK"}, {404, "Not Found"}, {500, "Server Error"}
+*   }};
+*   static_assert(codes.sorted(), "codes must be sorted by key");
+*
+* The items must be listed in increasing key order with no duplicates;
+* sorted() checks that and is meant for a static_assert. Lookups are binary
+* searches over the contiguous array and can run at compile time too. It
+* shares the find/operator[]/iteration interface of BinarySearchTree, with
+* iterators that are plain pointers to the items.
+*/
+template <class Key, class Value, size_t N>
+struct StaticMap
+{
+    typedef std::pair<Key, Value> value_type;
+    typedef const value_type* iterator;
+
+    constexpr size_t size() const { return N; }
+    constexpr bool empty() const { return N == 0; }
+    constexpr iterator begin() const { return items_; }
+    constexpr iterator end() const { return items_ + N; }
+
+    /*
+     * Returns an iterator to the key, or end() if absent.
+     */
+    constexpr iterator find(const Key& key) const
+    {
+      return found(key, lowerBound(key, 0, N)) ? items_ + lowerBound(key, 0, N) : end();
+    }
+
+    /**
+     * @precondition The key exists in the map
+     * Returns the value associated with the key. A missing key throws, or
+     * fails to compile when looked up in a constant expression.
+     */
+    constexpr const Value& operator[](const Key& key) const
+    {
+      return found(key, lowerBound(key, 0, N)) ? items_[lowerBound(key, 0, N)].second
+                                               : throw std::out_of_range("Invalid key");
+    }
+
+    /*
+     * True if the keys are strictly increasing. Splits the range in halves
+     * so the constexpr recursion stays log N deep.
+     */
+    constexpr bool sorted(size_t lo = 0, size_t hi = N) const
+    {
+      return hi - lo < 2 ||
+             (items_[lo + (hi - lo) / 2 - 1].first < items_[lo + (hi - lo) / 2].first &&
+              sorted(lo, lo + (hi - lo) / 2) && sorted(lo + (hi - lo) / 2, hi));
+    }
+
+    /*
+     * Index of the first key in [lo, hi) that is not below key, or hi.
+     */
+    constexpr size_t lowerBound(const Key& key, size_t lo, size_t hi) const
+    {
+      return lo >= hi ? lo
+           : items_[lo + (hi - lo) / 2].first < key ? lowerBound(key, lo + (hi - lo) / 2 + 1, hi)
+           : lowerBound(key, lo, lo + (hi - lo) / 2);
+    }
+
+    constexpr bool found(const Key& key, size_t i) const
+    {
+      return i < N && !(key < items_[i].first);
+    }
+
+    // public so the map can be brace-initialized; treat it as read only
+    value_type items_[N];
+};
+
+
+#endif
@@ -0,0 +1,273 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <cstddef>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <deque>
+#include <vector>
+#include <functional>
+#include <algorithm>
+#include <exception>
+
+class TaskGroup;
+
+/**
+* A fork-join thread pool with work stealing. Each worker keeps its own
+* deque of tasks: it pushes and pops at the back, so it works depth first
+* on what it split most recently, while idle workers steal from the front,
+* where the biggest pieces are. Threads outside the pool share one more
+* deque.
+*
+* A thread waiting on a TaskGroup runs queued tasks instead of blocking, so
+* recursive splitting cannot starve the pool, and the pool can have no
+* workers at all: shared() sizes itself to leave one hardware thread for
+* the caller, which on a single core means the caller does everything.
+*/
+class WorkStealingPool
+{
+public:
+    WorkStealingPool(unsigned workers);
+    ~WorkStealingPool();
+
+    static WorkStealingPool& shared();
+    unsigned workers() const;
+
+protected:
+    friend class TaskGroup;
+
+    struct Task
+    {
+      std::function<void()> run_;
+      TaskGroup* group_;
+    };
+    struct Queue
+    {
+      std::mutex lock_;
+      std::deque<Task> tasks_;
+    };
+
+    struct Worker
+    {
+      const WorkStealingPool* pool_;
+      size_t index_;
+    };
+    // the pool the calling thread works for, if any, and its queue there
+    static Worker& currentWorker()
+    {
+      static thread_local Worker worker = { NULL, 0 };
+      return worker;
+    }
+
+    size_t selfIndex() const;
+    void push(const Task& task);
+    bool runOne();
+    void workerLoop(size_t index);
+
+    WorkStealingPool(const WorkStealingPool&);
+    WorkStealingPool& operator=(const WorkStealingPool&);
+
+    // one deque per worker, and the last for threads outside the pool
+    std::vector<Queue*> queues_;
+    std::vector<std::thread> threads_;
+    std::atomic<size_t> queued_;
+    std::mutex sleepLock_;
+    std::condition_variable wake_;
+    bool stop_;
+};
+
+/**
+* A set of tasks run on a pool, and a wait for all of them. The first
+* exception a task throws is rethrown by wait().
+*/
+class TaskGroup
+{
+public:
+    TaskGroup(WorkStealingPool& pool) : pool_(pool), pending_(0) { }
+    ~TaskGroup();
+
+    void spawn(const std::function<void()>& task);
+    void wait();
+
+protected:
+    friend class WorkStealingPool;
+    void finished(std::exception_ptr error);
+
+    TaskGroup(const TaskGroup&);
+    TaskGroup& operator=(const TaskGroup&);
+
+    WorkStealingPool& pool_;
+    std::atomic<size_t> pending_;
+    std::mutex errorLock_;
+    std::exception_ptr error_;
+};
+
+
+inline WorkStealingPool::WorkStealingPool(unsigned workers) : queued_(0), stop_(false)
+{
+    for (unsigned i = 0; i <= workers; ++i) queues_.push_back(new Queue());
+    for (unsigned i = 0; i < workers; ++i)
+    {
+      threads_.push_back(std::thread(&WorkStealingPool::workerLoop, this, i));
+    }
+}
+
+/*
+ * Waits for the workers to finish what is queued, then stops them.
+ */
+inline WorkStealingPool::~WorkStealingPool()
+{
+    {
+      std::lock_guard<std::mutex> guard(sleepLock_);
+      stop_ = true;
+    }
+    wake_.notify_all();
+    for (size_t i = 0; i < threads_.size(); ++i) threads_[i].join();
+    for (size_t i = 0; i < queues_.size(); ++i) delete queues_[i];
+}
+
+/*
+ * The process-wide pool, started on first use.
+ */
+inline WorkStealingPool& WorkStealingPool::shared()
+{
+    static WorkStealingPool pool(std::max(1u, std::thread::hardware_concurrency()) - 1);
+    return pool;
+}
+
+inline unsigned WorkStealingPool::workers() const
+{
+    return static_cast<unsigned>(threads_.size());
+}
+
+/*
+ * The calling thread's own queue.
+ */
+inline size_t WorkStealingPool::selfIndex() const
+{
+    const Worker& worker = currentWorker();
+    return worker.pool_ == this ? worker.index_ : queues_.size() - 1;
+}
+
+inline void WorkStealingPool::push(const Task& task)
+{
+    Queue* queue = queues_[selfIndex()];
+    {
+      std::lock_guard<std::mutex> guard(queue->lock_);
+      queue->tasks_.push_back(task);
+    }
+    queued_++;
+    if (!threads_.empty())
+    {
+      // taking the lock orders this against a worker about to sleep
+      std::lock_guard<std::mutex> guard(sleepLock_);
+      wake_.notify_one();
+    }
+}
+
+/*
+ * Runs one task, the newest from our own queue or else the oldest from
+ * someone else's. Returns false if every queue was empty.
+ */
+inline bool WorkStealingPool::runOne()
+{
+    if (queued_.load() == 0) return false;
+    size_t self = selfIndex();
+    Task task;
+    bool found = false;
+    for (size_t i = 0; i < queues_.size() && !found; ++i)
+    {
+      Queue* queue = queues_[(self + i) % queues_.size()];
+      std::lock_guard<std::mutex> guard(queue->lock_);
+      if (queue->tasks_.empty()) continue;
+      if (i == 0)
+      {
+        task = queue->tasks_.back();
+        queue->tasks_.pop_back();
+      }
+      else
+      {
+        task = queue->tasks_.front();
+        queue->tasks_.pop_front();
+      }
+      found = true;
+    }
+    if (!found) return false;
+    queued_--;
+
+    std::exception_ptr error;
+    try
+    {
+      task.run_();
+    }
+    catch (...)
+    {
+      error = std::current_exception();
+    }
+    task.group_->finished(error);
+    return true;
+}
+
+inline void WorkStealingPool::workerLoop(size_t index)
+{
+    currentWorker().pool_ = this;
+    currentWorker().index_ = index;
+    while (true)
+    {
+      if (runOne()) continue;
+      std::unique_lock<std::mutex> guard(sleepLock_);
+      if (stop_ && queued_.load() == 0) return;
+      if (queued_.load() == 0) wake_.wait(guard);
+    }
+}
+
+/*
+ * A group must not be left with tasks still running.
+ */
+inline TaskGroup::~TaskGroup()
+{
+    while (pending_.load() != 0)
+    {
+      if (!pool_.runOne()) std::this_thread::yield();
+    }
+}
+
+inline void TaskGroup::spawn(const std::function<void()>& task)
+{
+    pending_++;
+    WorkStealingPool::Task t = { task, this };
+    pool_.push(t);
+}
+
+/*
+ * Runs queued tasks, ours or others', until all of ours are done.
+ */
+inline void TaskGroup::wait()
+{
+    while (pending_.load() != 0)
+    {
+      if (!pool_.runOne()) std::this_thread::yield();
+    }
+    std::lock_guard<std::mutex> guard(errorLock_);
+    if (error_)
+    {
+      std::exception_ptr error = error_;
+      error_ = std::exception_ptr();
+      std::rethrow_exception(error);
+    }
+}
+
+inline void TaskGroup::finished(std::exception_ptr error)
+{
+    if (error)
+    {
+      std::lock_guard<std::mutex> guard(errorLock_);
+      if (!error_) error_ = error;
+    }
+    pending_--;
+}
+
+
+#endif
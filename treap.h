@@ -0,0 +1,230 @@
+#ifndef TREAP_H
+#define TREAP_H
+
+#include <iostream>
+#include <exception>
+#include <cstdlib>
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+#include "bst.h"
+
+/**
+* A treap: a binary search tree by key that is also a max-heap by priority.
+* Priorities come from a hash of the key, so the shape of a treap depends
+* only on the set of keys it holds and nothing needs storing per node.
+* Every update is made of split and merge, which also give cheap range
+* extraction and concatenation.
+*/
+template <class Key, class Value>
+class Treap : public BinarySearchTree<Key, Value>
+{
+public:
+    virtual void insert (const std::pair<const Key, Value> &new_item);
+    virtual void remove(const Key& key);
+    virtual void erase(const Key& lo, const Key& hi);
+
+    Treap<Key, Value> extract(const Key& lo, const Key& hi);
+    void concat(Treap<Key, Value>& other);
+protected:
+    static uint64_t priority(const Key& key);
+    static bool above(Node<Key, Value>* a, Node<Key, Value>* b);
+    static Node<Key, Value>* merge(Node<Key, Value>* a, Node<Key, Value>* b);
+};
+
+/*
+ * Scrambles std::hash so that keys whose hashes are close (std::hash is the
+ * identity for integers on most libraries) still get unrelated priorities.
+ */
+template<class Key, class Value>
+uint64_t Treap<Key, Value>::priority(const Key& key)
+{
+    uint64_t h = std::hash<Key>()(key);
+    h += 0x9e3779b97f4a7c15ULL;
+    h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+    return h ^ (h >> 31);
+}
+
+/*
+ * True if a belongs above b in the heap. Ties, which only happen on hash
+ * collisions, are broken by key so the shape stays deterministic.
+ */
+template<class Key, class Value>
+bool Treap<Key, Value>::above(Node<Key, Value>* a, Node<Key, Value>* b)
+{
+    uint64_t pa = priority(a->getKey());
+    uint64_t pb = priority(b->getKey());
+    return pa > pb || (pa == pb && a->getKey() < b->getKey());
+}
+
+/*
+ * Recall: If key is already in the tree, you should
+ * overwrite the current value with the updated value.
+ * A new node walks down until it outranks the node in its way, then splits
+ * that subtree by its key and takes the two halves as its children.
+ */
+template<class Key, class Value>
+void Treap<Key, Value>::insert (const std::pair<const Key, Value> &new_item)
+{
+    Node<Key, Value>* existing = this->internalFind(new_item.first);
+    if (existing != NULL)
+    {
+      existing->setValue(new_item.second);
+      return;
+    }
+
+    Node<Key, Value>* newNode = new Node<Key, Value>(new_item.first, new_item.second, NULL);
+    Node<Key, Value>* parent = NULL;
+    Node<Key, Value>* traveler = this->root_;
+    while (traveler != NULL && above(traveler, newNode))
+    {
+      parent = traveler;
+      traveler = (new_item.first < traveler->getKey()) ? traveler->getLeft() : traveler->getRight();
+    }
+
+    Node<Key, Value>* lower;
+    Node<Key, Value>* upper;
+    this->splitAt(traveler, new_item.first, false, lower, upper);
+    newNode->setLeft(lower);
+    newNode->setRight(upper);
+    if (lower != NULL) lower->setParent(newNode);
+    if (upper != NULL) upper->setParent(newNode);
+
+    newNode->setParent(parent);
+    if (parent == NULL) this->root_ = newNode;
+    else if (new_item.first < parent->getKey()) parent->setLeft(newNode);
+    else parent->setRight(newNode);
+    this->size_++;
+}
+
+/*
+ * Replaces the node with the merge of its two subtrees.
+ */
+template<class Key, class Value>
+void Treap<Key, Value>::remove(const Key& key)
+{
+    Node<Key, Value>* removal = this->internalFind(key);
+    if (removal == NULL) return;
+
+    Node<Key, Value>* parent = removal->getParent();
+    Node<Key, Value>* left = removal->getLeft();
+    Node<Key, Value>* right = removal->getRight();
+    if (left != NULL) left->setParent(NULL);
+    if (right != NULL) right->setParent(NULL);
+    Node<Key, Value>* merged = merge(left, right);
+
+    if (merged != NULL) merged->setParent(parent);
+    if (parent == NULL) this->root_ = merged;
+    else if (parent->getLeft() == removal) parent->setLeft(merged);
+    else parent->setRight(merged);
+    delete removal;
+    this->size_--;
+}
+
+/*
+ * Removes every key k with lo <= k <= hi: two splits, one sweep to free the
+ * middle, one merge. O(log n + k).
+ */
+template<class Key, class Value>
+void Treap<Key, Value>::erase(const Key& lo, const Key& hi)
+{
+    if (hi < lo) return;
+    Node<Key, Value>* lower; Node<Key, Value>* rest;
+    Node<Key, Value>* range; Node<Key, Value>* upper;
+    this->splitAt(this->root_, lo, false, lower, rest);
+    this->splitAt(rest, hi, true, range, upper);
+    this->size_ -= this->destroySubtree(range);
+    this->root_ = merge(lower, upper);
+}
+
+/*
+ * Moves every key k with lo <= k <= hi out into a new treap. The splits and
+ * the merge are O(log n); recounting the sizes adds O(k).
+ */
+template<class Key, class Value>
+Treap<Key, Value> Treap<Key, Value>::extract(const Key& lo, const Key& hi)
+{
+    Treap<Key, Value> result;
+    if (hi < lo) return result;
+    Node<Key, Value>* lower; Node<Key, Value>* rest;
+    Node<Key, Value>* range; Node<Key, Value>* upper;
+    this->splitAt(this->root_, lo, false, lower, rest);
+    this->splitAt(rest, hi, true, range, upper);
+    this->root_ = merge(lower, upper);
+
+    result.root_ = range;
+    result.size_ = BinarySearchTree<Key, Value>::countNodes(range);
+    this->size_ -= result.size_;
+    return result;
+}
+
+/*
+ * Appends other, every one of whose keys must be greater than every key
+ * here, and leaves other empty. O(log n).
+ */
+template<class Key, class Value>
+void Treap<Key, Value>::concat(Treap<Key, Value>& other)
+{
+    if (&other == this || other.root_ == NULL) return;
+    if (this->root_ != NULL)
+    {
+      Node<Key, Value>* largest = this->root_;
+      while (largest->getRight() != NULL) largest = largest->getRight();
+      Node<Key, Value>* smallest = other.getSmallestNode();
+      if (!(largest->getKey() < smallest->getKey()))
+      {
+        throw std::invalid_argument("Treaps to concatenate overlap");
+      }
+    }
+    this->root_ = merge(this->root_, other.root_);
+    this->size_ += other.size_;
+    other.root_ = NULL;
+    other.size_ = 0;
+}
+
+/*
+ * Merges two detached treaps where every key of a is below every key of b.
+ * Walks down the right spine of a and the left spine of b together, always
+ * taking whichever root has the higher priority. Returns the detached root.
+ */
+template<class Key, class Value>
+Node<Key, Value>* Treap<Key, Value>::merge(Node<Key, Value>* a, Node<Key, Value>* b)
+{
+    Node<Key, Value>* root = NULL;
+    Node<Key, Value>* tail = NULL;
+    bool tailOnRight = false;
+    while (a != NULL && b != NULL)
+    {
+      Node<Key, Value>* next;
+      bool nextOnRight;
+      if (above(a, b))
+      {
+        next = a;
+        a = a->getRight();
+        nextOnRight = true;
+      }
+      else
+      {
+        next = b;
+        b = b->getLeft();
+        nextOnRight = false;
+      }
+      next->setParent(tail);
+      if (tail == NULL) root = next;
+      else if (tailOnRight) tail->setRight(next);
+      else tail->setLeft(next);
+      tail = next;
+      tailOnRight = nextOnRight;
+    }
+
+    Node<Key, Value>* rest = (a != NULL) ? a : b;
+    if (rest != NULL) rest->setParent(tail);
+    if (tail == NULL) root = rest;
+    else if (tailOnRight) tail->setRight(rest);
+    else tail->setLeft(rest);
+    return root;
+}
+
+
+#endif
@@ -0,0 +1,451 @@
+#ifndef WAVLBST_H
+#define WAVLBST_H
+
+#include <iostream>
+#include <exception>
+#include <cstdlib>
+#include <cstdint>
+#include "bst.h"
+
+/**
+* A special kind of node for a weak AVL tree, which adds the rank as a data member.
+* A missing child has rank -1 and a new leaf has rank 0.
+*/
+template <typename Key, typename Value>
+class WAVLNode : public Node<Key, Value>
+{
+public:
+    // Constructor/destructor.
+    WAVLNode(const Key& key, const Value& value, WAVLNode<Key, Value>* parent);
+    virtual ~WAVLNode();
+
+    // Getter/setter for the node's rank.
+    int8_t getRank() const;
+    void setRank(int8_t rank);
+    void updateRank(int8_t diff);
+
+    // Getters for parent, left, and right. These need to be redefined since they
+    // return pointers to WAVLNodes - not plain Nodes. See the Node class in bst.h
+    // for more information.
+    virtual WAVLNode<Key, Value>* getParent() const override;
+    virtual WAVLNode<Key, Value>* getLeft() const override;
+    virtual WAVLNode<Key, Value>* getRight() const override;
+
+protected:
+    int8_t rank_;
+};
+
+/*
+  -------------------------------------------------
+  Begin implementations for the WAVLNode class.
+  -------------------------------------------------
+*/
+
+/**
+* An explicit constructor to initialize the elements by calling the base class constructor and setting
+* the rank to 0 since every new node is a leaf when it is first inserted.
+*/
+template<class Key, class Value>
+WAVLNode<Key, Value>::WAVLNode(const Key& key, const Value& value, WAVLNode<Key, Value> *parent) :
+    Node<Key, Value>(key, value, parent), rank_(0)
+{
+
+}
+
+/**
+* A destructor which does nothing.
+*/
+template<class Key, class Value>
+WAVLNode<Key, Value>::~WAVLNode()
+{
+
+}
+
+/**
+* A getter for the rank of a WAVLNode.
+*/
+template<class Key, class Value>
+int8_t WAVLNode<Key, Value>::getRank() const
+{
+    return rank_;
+}
+
+/**
+* A setter for the rank of a WAVLNode.
+*/
+template<class Key, class Value>
+void WAVLNode<Key, Value>::setRank(int8_t rank)
+{
+    rank_ = rank;
+}
+
+/**
+* Adds diff to the rank of a WAVLNode.
+*/
+template<class Key, class Value>
+void WAVLNode<Key, Value>::updateRank(int8_t diff)
+{
+    rank_ += diff;
+}
+
+/**
+* An overridden function for getting the parent since a static_cast is necessary to make sure
+* that our node is a WAVLNode.
+*/
+template<class Key, class Value>
+WAVLNode<Key, Value> *WAVLNode<Key, Value>::getParent() const
+{
+    return static_cast<WAVLNode<Key, Value>*>(this->parent_);
+}
+
+/**
+* Overridden for the same reasons as above.
+*/
+template<class Key, class Value>
+WAVLNode<Key, Value> *WAVLNode<Key, Value>::getLeft() const
+{
+    return static_cast<WAVLNode<Key, Value>*>(this->left_);
+}
+
+/**
+* Overridden for the same reasons as above.
+*/
+template<class Key, class Value>
+WAVLNode<Key, Value> *WAVLNode<Key, Value>::getRight() const
+{
+    return static_cast<WAVLNode<Key, Value>*>(this->right_);
+}
+
+
+/*
+  -----------------------------------------------
+  End implementations for the WAVLNode class.
+  -----------------------------------------------
+*/
+
+
+/**
+* A weak AVL tree. Every rank difference between a node and its child is 1 or
+* 2, and every leaf has rank 0. With only inserts the tree is exactly an AVL
+* tree; removes relax it just enough that each update does amortized O(1)
+* rebalancing and at most two rotations, while the height stays under 2 log n.
+*/
+template <class Key, class Value>
+class WAVLTree : public BinarySearchTree<Key, Value>
+{
+public:
+    WAVLTree();
+    WAVLTree(const WAVLTree<Key, Value>& other);
+    WAVLTree(WAVLTree<Key, Value>&& other);
+    WAVLTree<Key, Value>& operator=(const WAVLTree<Key, Value>& other);
+    WAVLTree<Key, Value>& operator=(WAVLTree<Key, Value>&& other);
+
+    virtual void insert (const std::pair<const Key, Value> &new_item);
+    virtual void remove(const Key& key);
+    virtual void erase(const Key& lo, const Key& hi);
+protected:
+    virtual void nodeSwap( WAVLNode<Key,Value>* n1, WAVLNode<Key,Value>* n2);
+    virtual Node<Key, Value>* cloneNode(const Node<Key, Value>* src, Node<Key, Value>* parent) const;
+
+    WAVLNode<Key, Value>* conversion(Node<Key, Value>* n) const;
+    static int rank(WAVLNode<Key, Value>* n);
+    void insertFix(WAVLNode<Key, Value>* n);
+    void removeFix(WAVLNode<Key, Value>* n, WAVLNode<Key, Value>* p);
+    void removeNode(WAVLNode<Key, Value>* removal);
+};
+
+
+template<class Key, class Value>
+WAVLTree<Key, Value>::WAVLTree() : BinarySearchTree<Key, Value>()
+{
+
+}
+
+/*
+ * See the AVLTree copy constructor for why the copy is made here.
+ */
+template<class Key, class Value>
+WAVLTree<Key, Value>::WAVLTree(const WAVLTree<Key, Value>& other) : BinarySearchTree<Key, Value>()
+{
+    this->copyFrom(other);
+}
+
+template<class Key, class Value>
+WAVLTree<Key, Value>::WAVLTree(WAVLTree<Key, Value>&& other) :
+    BinarySearchTree<Key, Value>(std::move(other))
+{
+
+}
+
+template<class Key, class Value>
+WAVLTree<Key, Value>& WAVLTree<Key, Value>::operator=(const WAVLTree<Key, Value>& other)
+{
+    BinarySearchTree<Key, Value>::operator=(other);
+    return *this;
+}
+
+template<class Key, class Value>
+WAVLTree<Key, Value>& WAVLTree<Key, Value>::operator=(WAVLTree<Key, Value>&& other)
+{
+    BinarySearchTree<Key, Value>::operator=(std::move(other));
+    return *this;
+}
+
+template<class Key, class Value>
+WAVLNode<Key, Value> *WAVLTree<Key, Value>::conversion(Node<Key, Value>* n) const
+{
+    return static_cast<WAVLNode<Key, Value>*>(n);
+}
+
+/*
+ * Missing children have rank -1.
+ */
+template<class Key, class Value>
+int WAVLTree<Key, Value>::rank(WAVLNode<Key, Value>* n)
+{
+    return (n == NULL) ? -1 : n->getRank();
+}
+
+template<class Key, class Value>
+Node<Key, Value>* WAVLTree<Key, Value>::cloneNode(const Node<Key, Value>* src, Node<Key, Value>* parent) const
+{
+    WAVLNode<Key, Value>* n = new WAVLNode<Key, Value>(src->getKey(), src->getValue(), conversion(parent));
+    n->setRank(static_cast<const WAVLNode<Key, Value>*>(src)->getRank());
+    return n;
+}
+
+/*
+ * Recall: If key is already in the tree, you should
+ * overwrite the current value with the updated value.
+ */
+template<class Key, class Value>
+void WAVLTree<Key, Value>::insert (const std::pair<const Key, Value> &new_item)
+{
+    WAVLNode<Key, Value>* parent = NULL;
+    WAVLNode<Key, Value>* traveler = conversion(this->root_);
+    while (traveler != NULL)
+    {
+      if (new_item.first < traveler->getKey())
+      {
+        parent = traveler;
+        traveler = traveler->getLeft();
+      }
+      else if (traveler->getKey() < new_item.first)
+      {
+        parent = traveler;
+        traveler = traveler->getRight();
+      }
+      // if key is the same, set the value
+      else
+      {
+        traveler->setValue(new_item.second);
+        return;
+      }
+    }
+
+    WAVLNode<Key, Value>* newNode = new WAVLNode<Key, Value>(new_item.first, new_item.second, parent);
+    if (parent == NULL) this->root_ = newNode;
+    else if (new_item.first < parent->getKey()) parent->setLeft(newNode);
+    else parent->setRight(newNode);
+    this->size_++;
+    insertFix(newNode);
+}
+
+/*
+ * n may now have the same rank as its parent. Promote the parent while its
+ * other child is a 1-child, which moves the problem up; otherwise one single
+ * or double rotation finishes the fix.
+ */
+template<class Key, class Value>
+void WAVLTree<Key, Value>::insertFix(WAVLNode<Key, Value>* n)
+{
+  WAVLNode<Key, Value>* p = n->getParent();
+  while (p != NULL && p->getRank() == n->getRank())
+  {
+    bool nIsLeft = (p->getLeft() == n);
+    WAVLNode<Key, Value>* s = nIsLeft ? p->getRight() : p->getLeft();
+    if (p->getRank() - rank(s) == 1)
+    {
+      p->updateRank(1);
+      n = p;
+      p = n->getParent();
+      continue;
+    }
+
+    // p is a 0,2 node; y is n's child on the inside, next to s
+    WAVLNode<Key, Value>* y = nIsLeft ? n->getRight() : n->getLeft();
+    if (n->getRank() - rank(y) == 2)
+    {
+      if (nIsLeft) this->rotateRight(p);
+      else this->rotateLeft(p);
+      p->updateRank(-1);
+    }
+    else
+    {
+      if (nIsLeft)
+      {
+        this->rotateLeft(n);
+        this->rotateRight(p);
+      }
+      else
+      {
+        this->rotateRight(n);
+        this->rotateLeft(p);
+      }
+      y->updateRank(1);
+      n->updateRank(-1);
+      p->updateRank(-1);
+    }
+    break;
+  }
+}
+
+/*
+ * Recall: The writeup specifies that if a node has 2 children you
+ * should swap with the predecessor and then remove.
+ */
+template<class Key, class Value>
+void WAVLTree<Key, Value>::remove(const Key& key)
+{
+    WAVLNode<Key, Value>* removal = conversion(this->internalFind(key));
+    if (removal == NULL) return;
+    removeNode(removal);
+}
+
+/*
+ * Removes every key k with lo <= k <= hi, node by node, since the base class
+ * split and rejoin knows nothing about ranks.
+ */
+template<class Key, class Value>
+void WAVLTree<Key, Value>::erase(const Key& lo, const Key& hi)
+{
+    if (hi < lo) return;
+    Node<Key, Value>* n = this->root_;
+    Node<Key, Value>* first = NULL;
+    while (n != NULL)
+    {
+      if (n->getKey() < lo) n = n->getRight();
+      else
+      {
+        first = n;
+        n = n->getLeft();
+      }
+    }
+    while (first != NULL && !(hi < first->getKey()))
+    {
+      // removeNode only ever moves the predecessor, so the successor stays put
+      Node<Key, Value>* next = first;
+      BinarySearchTree<Key, Value>::successor(next);
+      removeNode(conversion(first));
+      first = next;
+    }
+}
+
+/*
+ * Unlinks and frees the given node, then repairs ranks above it.
+ */
+template<class Key, class Value>
+void WAVLTree<Key, Value>::removeNode(WAVLNode<Key, Value>* removal)
+{
+    // 2 child case --> swap with the predecessor, which has at most a left child
+    if (removal->getLeft() != NULL && removal->getRight() != NULL)
+    {
+      nodeSwap(removal, conversion(this->predecessor(removal)));
+    }
+
+    WAVLNode<Key, Value>* child = removal->getLeft();
+    if (child == NULL) child = removal->getRight();
+    WAVLNode<Key, Value>* p = removal->getParent();
+    if (p == NULL) this->root_ = child;
+    else if (p->getLeft() == removal) p->setLeft(child);
+    else p->setRight(child);
+    if (child != NULL) child->setParent(p);
+
+    delete removal;
+    this->size_--;
+    removeFix(child, p);
+}
+
+/*
+ * n (possibly NULL) is the child of p that lost a descendant. A leaf left
+ * with rank 1 is demoted first. Then, while n is a 3-child, demote p (and
+ * its sibling, if both its children are 2-children) and move up, or rotate
+ * once or twice and stop.
+ */
+template<class Key, class Value>
+void WAVLTree<Key, Value>::removeFix(WAVLNode<Key, Value>* n, WAVLNode<Key, Value>* p)
+{
+  if (p == NULL) return;
+  if (p->getLeft() == NULL && p->getRight() == NULL && p->getRank() == 1)
+  {
+    p->setRank(0);
+    n = p;
+    p = n->getParent();
+  }
+
+  while (p != NULL && p->getRank() - rank(n) == 3)
+  {
+    bool nIsLeft = (p->getLeft() == n);
+    // p has rank at least 2, so the sibling exists
+    WAVLNode<Key, Value>* s = nIsLeft ? p->getRight() : p->getLeft();
+    if (p->getRank() - s->getRank() == 2)
+    {
+      p->updateRank(-1);
+      n = p;
+      p = n->getParent();
+      continue;
+    }
+    WAVLNode<Key, Value>* inner = nIsLeft ? s->getLeft() : s->getRight();
+    WAVLNode<Key, Value>* outer = nIsLeft ? s->getRight() : s->getLeft();
+    if (s->getRank() - rank(inner) == 2 && s->getRank() - rank(outer) == 2)
+    {
+      s->updateRank(-1);
+      p->updateRank(-1);
+      n = p;
+      p = n->getParent();
+      continue;
+    }
+
+    if (s->getRank() - rank(outer) == 1)
+    {
+      if (nIsLeft) this->rotateLeft(p);
+      else this->rotateRight(p);
+      s->updateRank(1);
+      p->updateRank(-1);
+      // a leaf cannot keep rank 1
+      if (p->getLeft() == NULL && p->getRight() == NULL) p->updateRank(-1);
+    }
+    else
+    {
+      if (nIsLeft)
+      {
+        this->rotateRight(s);
+        this->rotateLeft(p);
+      }
+      else
+      {
+        this->rotateLeft(s);
+        this->rotateRight(p);
+      }
+      inner->updateRank(2);
+      s->updateRank(-1);
+      p->updateRank(-2);
+    }
+    break;
+  }
+}
+
+/*
+ * Ranks belong to positions in the tree, so they are swapped along with the nodes.
+ */
+template<class Key, class Value>
+void WAVLTree<Key, Value>::nodeSwap( WAVLNode<Key,Value>* n1, WAVLNode<Key,Value>* n2)
+{
+    BinarySearchTree<Key, Value>::nodeSwap(n1, n2);
+    int8_t tempR = n1->getRank();
+    n1->setRank(n2->getRank());
+    n2->setRank(tempR);
+}
+
+
+#endif
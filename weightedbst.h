@@ -0,0 +1,384 @@
+#ifndef WEIGHTEDBST_H
+#define WEIGHTEDBST_H
+
+#include <iostream>
+#include <exception>
+#include <cstdlib>
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <unordered_map>
+#include <memory>
+#include <atomic>
+#include <stdexcept>
+#include "bst.h"
+
+/**
+* A tree for read-mostly workloads with skewed key popularity. Lookups through
+* a non-const tree sample how often each key is hit, and the tree is
+* periodically rebuilt so that each key's depth is about log(total / weight):
+* the expected search cost then tracks the entropy of the access
+* distribution rather than log n. It uses the plain Node.
+*
+* The new shape is computed as a task on the shared WorkStealingPool from a
+* snapshot of the weights and installed by the next sampled lookup once it
+* is ready, unless an insert or remove changed the key set in the meantime.
+* When the pool has no workers (a single core) the lookup that starts the
+* rebuild does it on the spot. Nodes are relinked
+* rather than copied, so references and iterators stay valid. Between
+* rebuilds, inserts and removes behave like the plain tree's.
+*
+* Keys need a std::hash specialization for the access counts.
+*/
+template <class Key, class Value>
+class WeightedTree : public BinarySearchTree<Key, Value>
+{
+public:
+    typedef typename BinarySearchTree<Key, Value>::iterator iterator;
+    using BinarySearchTree<Key, Value>::find;
+    using BinarySearchTree<Key, Value>::operator[];
+
+    WeightedTree(size_t rebuildEvery = 1 << 16, unsigned sampleEvery = 4);
+    WeightedTree(const WeightedTree<Key, Value>& other);
+    WeightedTree(WeightedTree<Key, Value>&& other);
+    WeightedTree<Key, Value>& operator=(const WeightedTree<Key, Value>& other);
+    WeightedTree<Key, Value>& operator=(WeightedTree<Key, Value>&& other);
+
+    virtual void insert (const std::pair<const Key, Value> &new_item);
+    virtual void remove(const Key& key);
+    virtual void erase(const Key& lo, const Key& hi);
+    void clear();
+    iterator find(const Key& key);
+    Value& operator[](const Key& key);
+
+    void rebuildByWeight();
+protected:
+    Node<Key, Value>* access(const Key& key);
+    std::vector<size_t> takeWeights();
+    static std::vector<size_t> shapeByWeight(std::vector<size_t> weights);
+    void installShape(const std::vector<size_t>& parents);
+    void collectRebuild();
+
+    /*
+     * A shape being built on the pool. The task holds the job too, so the
+     * tree can drop it, or go away, without waiting; the group exists
+     * because the pool only runs tasks on behalf of one.
+     */
+    struct PendingShape
+    {
+      PendingShape() : group_(WorkStealingPool::shared()), ready_(false) { }
+      TaskGroup group_;
+      std::vector<size_t> weights_;
+      std::vector<size_t> parents_;
+      std::atomic<bool> ready_;
+    };
+
+    std::unordered_map<Key, size_t> counts_;
+    // rebuild after this many lookups, and no sooner than four per key so
+    // the O(n) snapshot stays amortized; 0 only rebuilds on request
+    size_t rebuildEvery_;
+    // count one lookup in this many
+    unsigned sampleEvery_;
+    size_t accesses_;
+    size_t sinceRebuild_;
+    // bumped whenever the key set changes, to spot stale shapes
+    size_t modCount_;
+    std::shared_ptr<PendingShape> pending_;
+    size_t pendingMod_;
+};
+
+
+template<class Key, class Value>
+WeightedTree<Key, Value>::WeightedTree(size_t rebuildEvery, unsigned sampleEvery) :
+    BinarySearchTree<Key, Value>(),
+    rebuildEvery_(rebuildEvery), sampleEvery_(sampleEvery),
+    accesses_(0), sinceRebuild_(0), modCount_(0), pendingMod_(0)
+{
+    if (sampleEvery == 0) throw std::invalid_argument("sampleEvery must be positive");
+}
+
+/*
+ * Copies the tree and its access counts; a rebuild in flight is not copied.
+ */
+template<class Key, class Value>
+WeightedTree<Key, Value>::WeightedTree(const WeightedTree<Key, Value>& other) :
+    BinarySearchTree<Key, Value>(other),
+    counts_(other.counts_),
+    rebuildEvery_(other.rebuildEvery_), sampleEvery_(other.sampleEvery_),
+    accesses_(0), sinceRebuild_(0), modCount_(0), pendingMod_(0)
+{
+
+}
+
+/*
+ * A pending shape describes nodes by their in-order position, so it moves
+ * along with the nodes.
+ */
+template<class Key, class Value>
+WeightedTree<Key, Value>::WeightedTree(WeightedTree<Key, Value>&& other) :
+    BinarySearchTree<Key, Value>(std::move(other)),
+    counts_(std::move(other.counts_)),
+    rebuildEvery_(other.rebuildEvery_), sampleEvery_(other.sampleEvery_),
+    accesses_(other.accesses_), sinceRebuild_(other.sinceRebuild_),
+    modCount_(other.modCount_), pending_(std::move(other.pending_)),
+    pendingMod_(other.pendingMod_)
+{
+
+}
+
+template<class Key, class Value>
+WeightedTree<Key, Value>& WeightedTree<Key, Value>::operator=(const WeightedTree<Key, Value>& other)
+{
+    if (this != &other)
+    {
+      BinarySearchTree<Key, Value>::operator=(other);
+      counts_ = other.counts_;
+      rebuildEvery_ = other.rebuildEvery_;
+      sampleEvery_ = other.sampleEvery_;
+      sinceRebuild_ = 0;
+      modCount_++;
+    }
+    return *this;
+}
+
+template<class Key, class Value>
+WeightedTree<Key, Value>& WeightedTree<Key, Value>::operator=(WeightedTree<Key, Value>&& other)
+{
+    if (this != &other)
+    {
+      BinarySearchTree<Key, Value>::operator=(std::move(other));
+      counts_ = std::move(other.counts_);
+      rebuildEvery_ = other.rebuildEvery_;
+      sampleEvery_ = other.sampleEvery_;
+      accesses_ = other.accesses_;
+      sinceRebuild_ = other.sinceRebuild_;
+      modCount_ = other.modCount_;
+      pending_ = std::move(other.pending_);
+      pendingMod_ = other.pendingMod_;
+    }
+    return *this;
+}
+
+/*
+ * Recall: If key is already in the tree, you should
+ * overwrite the current value with the updated value.
+ */
+template<class Key, class Value>
+void WeightedTree<Key, Value>::insert (const std::pair<const Key, Value> &new_item)
+{
+    size_t before = this->size_;
+    BinarySearchTree<Key, Value>::insert(new_item);
+    if (this->size_ != before) modCount_++;
+}
+
+template<class Key, class Value>
+void WeightedTree<Key, Value>::remove(const Key& key)
+{
+    size_t before = this->size_;
+    BinarySearchTree<Key, Value>::remove(key);
+    if (this->size_ != before) modCount_++;
+}
+
+template<class Key, class Value>
+void WeightedTree<Key, Value>::erase(const Key& lo, const Key& hi)
+{
+    size_t before = this->size_;
+    BinarySearchTree<Key, Value>::erase(lo, hi);
+    if (this->size_ != before) modCount_++;
+}
+
+template<class Key, class Value>
+void WeightedTree<Key, Value>::clear()
+{
+    BinarySearchTree<Key, Value>::clear();
+    counts_.clear();
+    sinceRebuild_ = 0;
+    modCount_++;
+}
+
+/*
+ * Returns an iterator to the key, or end() if absent, counting the lookup.
+ */
+template<class Key, class Value>
+typename WeightedTree<Key, Value>::iterator WeightedTree<Key, Value>::find(const Key& key)
+{
+    return this->iteratorAt(access(key));
+}
+
+/**
+ * @precondition The key exists in the map
+ * Returns the value associated with the key, counting the lookup
+ */
+template<class Key, class Value>
+Value& WeightedTree<Key, Value>::operator[](const Key& key)
+{
+    Node<Key, Value>* curr = access(key);
+    if(curr == NULL) throw std::out_of_range("Invalid key");
+    return curr->getValue();
+}
+
+/*
+ * Rebuilds the tree by the access counts gathered so far, right away and on
+ * this thread. O(n log n).
+ */
+template<class Key, class Value>
+void WeightedTree<Key, Value>::rebuildByWeight()
+{
+    // a shape still in flight was built from older counts
+    pending_.reset();
+    installShape(shapeByWeight(takeWeights()));
+    sinceRebuild_ = 0;
+}
+
+/*
+ * Looks up key. Every sampleEvery-th lookup is counted, installs a finished
+ * background rebuild, and starts a new one when enough lookups have passed.
+ */
+template<class Key, class Value>
+Node<Key, Value>* WeightedTree<Key, Value>::access(const Key& key)
+{
+    Node<Key, Value>* n = this->internalFind(key);
+    if (++accesses_ % sampleEvery_ != 0) return n;
+
+    if (n != NULL) counts_[key]++;
+    sinceRebuild_ += sampleEvery_;
+    if (pending_)
+    {
+      collectRebuild();
+    }
+    else if (rebuildEvery_ != 0 && sinceRebuild_ >= rebuildEvery_ &&
+             sinceRebuild_ >= 4 * this->size_ && this->size_ > 1)
+    {
+      if (WorkStealingPool::shared().workers() == 0)
+      {
+        installShape(shapeByWeight(takeWeights()));
+      }
+      else
+      {
+        std::shared_ptr<PendingShape> job = std::make_shared<PendingShape>();
+        job->weights_ = takeWeights();
+        job->group_.spawn([job]() {
+          job->parents_ = shapeByWeight(std::move(job->weights_));
+          job->ready_.store(true, std::memory_order_release);
+        });
+        pending_ = job;
+        pendingMod_ = modCount_;
+      }
+      sinceRebuild_ = 0;
+    }
+    return n;
+}
+
+/*
+ * Installs the background shape if it is done and still matches the keys.
+ * A stale shape is dropped; the next round starts from fresh counts.
+ */
+template<class Key, class Value>
+void WeightedTree<Key, Value>::collectRebuild()
+{
+    if (!pending_->ready_.load(std::memory_order_acquire)) return;
+    std::shared_ptr<PendingShape> job;
+    job.swap(pending_);
+    if (pendingMod_ == modCount_) installShape(job->parents_);
+}
+
+/*
+ * Returns the weight of each key in order, one plus its count, and halves
+ * the counts so that the next rebuild favours recent popularity. Counts of
+ * keys that have left the tree are dropped here.
+ */
+template<class Key, class Value>
+std::vector<size_t> WeightedTree<Key, Value>::takeWeights()
+{
+    std::vector<size_t> weights;
+    weights.reserve(this->size_);
+    std::unordered_map<Key, size_t> aged;
+    for (iterator it = this->begin(); it != this->end(); ++it)
+    {
+      size_t count = 0;
+      typename std::unordered_map<Key, size_t>::const_iterator c = counts_.find(it->first);
+      if (c != counts_.end()) count = c->second;
+      weights.push_back(1 + count);
+      if (count > 1) aged[it->first] = count / 2;
+    }
+    counts_.swap(aged);
+    return weights;
+}
+
+/*
+ * Picks, for each range of keys, the root whose weight straddles the middle
+ * of the range's total weight (Mehlhorn's bisection rule), which puts every
+ * key within about log(total / weight) + 2 of the root. Returns the in-order
+ * index of each key's parent, or n for the root. Touches no nodes, so it can
+ * run on any thread.
+ */
+template<class Key, class Value>
+std::vector<size_t> WeightedTree<Key, Value>::shapeByWeight(std::vector<size_t> weights)
+{
+    size_t n = weights.size();
+    std::vector<size_t> prefix(n + 1, 0);
+    for (size_t i = 0; i < n; ++i) prefix[i + 1] = prefix[i] + weights[i];
+
+    std::vector<size_t> parents(n, n);
+    struct Range { size_t lo, hi, parent; };
+    std::vector<Range> ranges;
+    Range all = { 0, n, n };
+    ranges.push_back(all);
+    while (!ranges.empty())
+    {
+      Range r = ranges.back();
+      ranges.pop_back();
+      if (r.lo >= r.hi) continue;
+      size_t half = prefix[r.lo] + (prefix[r.hi] - prefix[r.lo]) / 2;
+      // the key whose slice [prefix[i], prefix[i+1]) holds the midpoint
+      size_t root = std::upper_bound(prefix.begin() + r.lo + 1, prefix.begin() + r.hi + 1, half)
+          - prefix.begin() - 1;
+      parents[root] = r.parent;
+      Range left = { r.lo, root, root };
+      Range right = { root + 1, r.hi, root };
+      ranges.push_back(left);
+      ranges.push_back(right);
+    }
+    return parents;
+}
+
+/*
+ * Relinks the nodes, taken in order, into the shape given by parents.
+ */
+template<class Key, class Value>
+void WeightedTree<Key, Value>::installShape(const std::vector<size_t>& parents)
+{
+    size_t n = parents.size();
+    if (n != this->size_) return;
+    std::vector<Node<Key, Value>*> nodes;
+    nodes.reserve(n);
+    for (Node<Key, Value>* curr = this->getSmallestNode(); curr != NULL;
+         BinarySearchTree<Key, Value>::successor(curr))
+    {
+      nodes.push_back(curr);
+    }
+
+    for (size_t i = 0; i < n; ++i)
+    {
+      nodes[i]->setLeft(NULL);
+      nodes[i]->setRight(NULL);
+    }
+    for (size_t i = 0; i < n; ++i)
+    {
+      size_t p = parents[i];
+      if (p == n)
+      {
+        nodes[i]->setParent(NULL);
+        this->root_ = nodes[i];
+      }
+      else
+      {
+        nodes[i]->setParent(nodes[p]);
+        if (i < p) nodes[p]->setLeft(nodes[i]);
+        else nodes[p]->setRight(nodes[i]);
+      }
+    }
+}
+
+
+#endif